@@ -11,8 +11,10 @@
 
 #pragma once
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #define LTL2BA_VERSION_MAJOR 2
 #define LTL2BA_VERSION_MINOR 1
@@ -20,7 +22,6 @@
 /* LTL2BA_EMPTY_SET is passed to make_set() to create empty */
 #define LTL2BA_EMPTY_SET   (-1)
 #define LTL2BA_SET_SIZE(n) (n / (8 * sizeof(int)) + 1)
-#define LTL2BA_Nhash       255
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,9 +29,34 @@ extern "C" {
 
 const char * ltl2ba_version(void);
 
+/* Why a translation has stopped before its end, see ltl2ba_set_deadline() */
+typedef enum {
+	LTL2BA_OK,        /* not stopped */
+	LTL2BA_CANCELLED, /* the cancellation flag was set */
+	LTL2BA_DEADLINE,  /* the deadline has passed */
+} ltl2ba_Status;
+
+/* The translations stop at the first check after the deadline, a time of
+ * CLOCK_MONOTONIC, or after *flag becomes nonzero, e.g. in a signal handler
+ * or another thread. NULL removes the deadline or the flag. The automata of a
+ * stopped translation must not be used, apart from their status. */
+void ltl2ba_set_deadline(const struct timespec *deadline);
+void ltl2ba_set_cancel(const volatile sig_atomic_t *flag);
+
+/* The C outputs analyse the letters of the automata in up to n threads at
+ * once, the calling one included. 1 keeps the work in the calling thread,
+ * 0, the default, uses one thread per online processor. */
+void ltl2ba_set_threads(int n);
+
+typedef enum {
+	LTL2BA_SYM_ATOM,  /* propositional atom, printed as its name */
+	LTL2BA_SYM_CEXPR, /* {C expression} atom */
+} ltl2ba_SymKind;
+
 typedef struct ltl2ba_Symbol {
 	char *name;
-	struct ltl2ba_Symbol *next; /* linked list, symbol table */
+	ltl2ba_SymKind kind;
+	int cexpr;                  /* index in the Cexprtab, if LTL2BA_SYM_CEXPR */
 } ltl2ba_Symbol;
 
 typedef struct ltl2ba_Node {
@@ -62,6 +88,8 @@ typedef struct ltl2ba_GTrans {
 	struct ltl2ba_GState *to;
 	int *final;
 	struct ltl2ba_GTrans *nxt;
+	struct ltl2ba_GState *from;
+	struct ltl2ba_GTrans *in_nxt, *in_prv; /* transitions to 'to' */
 } ltl2ba_GTrans;
 
 typedef struct ltl2ba_GState {
@@ -69,8 +97,10 @@ typedef struct ltl2ba_GState {
 	int incoming;
 	int *nodes_set;
 	struct ltl2ba_GTrans *trans;
+	struct ltl2ba_GTrans *in; /* transitions to this state */
 	struct ltl2ba_GState *nxt;
 	struct ltl2ba_GState *prv;
+	int dirty; /* what the simplifications must re-examine */
 } ltl2ba_GState;
 
 typedef struct ltl2ba_BTrans {
@@ -78,6 +108,8 @@ typedef struct ltl2ba_BTrans {
 	int *pos;
 	int *neg;
 	struct ltl2ba_BTrans *nxt;
+	struct ltl2ba_BState *from;
+	struct ltl2ba_BTrans *in_nxt, *in_prv; /* transitions to 'to' */
 } ltl2ba_BTrans;
 
 typedef struct ltl2ba_BState {
@@ -86,9 +118,11 @@ typedef struct ltl2ba_BState {
 	int incoming;
 	int final;
 	struct ltl2ba_BTrans *trans;
+	struct ltl2ba_BTrans *in; /* transitions to this state */
 	struct ltl2ba_BState *nxt;
 	struct ltl2ba_BState *prv;
 	int label;  /* DAN */
+	int dirty;  /* what the simplifications must re-examine */
 } ltl2ba_BState;
 
 enum {
@@ -107,21 +141,35 @@ enum {
 	LTL2BA_NEXT,       /* 269 */
 };
 
-typedef ltl2ba_Symbol *ltl2ba_Symtab[LTL2BA_Nhash + 1];
+/* Interned symbols: an array of one element, so that a zeroed Symtab is an
+ * empty table and a Symtab is passed by reference. */
+typedef struct {
+	ltl2ba_Symbol **slots;       /* open addressing, or NULL */
+	int size, count;             /* size is 0 or a power of 2 */
+	struct ltl2ba_Arena *arena;  /* storage of the symbols and their names */
+} ltl2ba_Symtab[1];
 
 typedef struct {
-	int cexpr_idx;
-	char *cexpr_expr_table[256];
+	int cexpr_idx;           /* number of C expressions */
+	int cexpr_size;          /* allocated size of cexpr_expr_table */
+	char **cexpr_expr_table;
+	int *cexpr_hash;         /* open addressing on the expressions: index + 1
+	                            of an expression, or 0 */
+	int cexpr_hash_size;     /* 0 or a power of 2 */
 } ltl2ba_Cexprtab;
 
 typedef struct {
 	ltl2ba_Node *tl_yylval;
 	int tl_yychar;
-	char yytext[2048];
+	char *yytext;
+	int yytext_size;
+	const char *buf;  /* the formula, owned by the caller */
+	size_t len, pos;  /* pos may go past len, once per read at the end */
+	struct ltl2ba_Implied *implied; /* memo of the parser simplifier */
 } ltl2ba_Lexer;
 
 typedef enum {
-	LTL2BA_STATS     = 1 << 0, /* time and size stats */
+	LTL2BA_STATS     = 1 << 0, /* deprecated, ignored: pass a ltl2ba_Stats */
 	LTL2BA_SIMP_LOG  = 1 << 1, /* logical simplification */
 	LTL2BA_SIMP_DIFF = 1 << 2, /* automata simplification */
 	LTL2BA_SIMP_FLY  = 1 << 3, /* on the fly simplification */
@@ -141,7 +189,7 @@ typedef struct {
 	int *final_set;
 	int node_id; /* really the number of nodes */
 	int sym_id;  /* number of symbols */
-	const char **sym_table;
+	const ltl2ba_Symbol **sym_table;
 	ltl2ba_set_sizes sz;
 } ltl2ba_Alternating;
 
@@ -149,14 +197,114 @@ typedef struct {
 	ltl2ba_GState *gstates, **init;
 	int init_size, gstate_id, *final, scc_size;
 	ltl2ba_set_sizes sz; /* copy from Alternating automaton */
+	ltl2ba_Status status;
 } ltl2ba_Generalized;
 
 typedef struct {
 	ltl2ba_BState *bstates;
 	int accept;
 	ltl2ba_set_sizes sz; /* copy from Generalized automaton */
+	ltl2ba_Status status;
 } ltl2ba_Buchi;
 
+/* Buchi automaton built on demand, see mk_lazy_buchi() */
+typedef struct {
+	ltl2ba_Generalized g;  /* generalized states solved so far */
+	ltl2ba_Buchi b;        /* Buchi states solved so far */
+	ltl2ba_BState *init;   /* initial Buchi state, once computed */
+	const ltl2ba_Alternating *alt;
+	ltl2ba_Flags flags;
+	ltl2ba_GState *gstack, *gremoved; /* states to solve, removed states */
+	ltl2ba_BState *bstack, *bremoved;
+	ltl2ba_BTrans *none;   /* empty list of transitions */
+	int *fin;
+} ltl2ba_Lazy;
+
+/* Statistics of the translation, gathered by mk_alternating(),
+ * mk_generalized() and mk_buchi() when they are given a ltl2ba_Stats. */
+
+#define LTL2BA_POOL_SIZES 80
+
+typedef struct {
+	double wall; /* seconds of CLOCK_MONOTONIC */
+	double cpu;  /* seconds of user and system time of the process */
+} ltl2ba_Time;
+
+typedef enum {
+	LTL2BA_PASS_ASTATES, /* unreachable states of the alternating automaton */
+	LTL2BA_PASS_GTRANS,  /* redundant transitions of the generalized one */
+	LTL2BA_PASS_GSTATES, /* equivalent states of the generalized one */
+	LTL2BA_PASS_GSCC,    /* strongly connected components of the generalized one */
+	LTL2BA_PASS_BTRANS,  /* redundant transitions of the Buchi one */
+	LTL2BA_PASS_BSTATES, /* equivalent states of the Buchi one */
+	LTL2BA_PASS_BSCC,    /* strongly connected components of the Buchi one */
+} ltl2ba_PassKind;
+
+/* a simplification pass */
+typedef struct {
+	ltl2ba_PassKind kind;
+	ltl2ba_Time time;
+	int states_before, trans_before;
+	int states_after, trans_after;
+} ltl2ba_Pass;
+
+/* the building of an automaton, then its simplification passes in order */
+typedef struct {
+	ltl2ba_Time time;     /* the whole stage */
+	ltl2ba_Time build;    /* the building alone */
+	int states, trans;    /* as built */
+	ltl2ba_Pass *passes;
+	int npasses, passes_size;
+} ltl2ba_Stage;
+
+typedef struct {
+	long pool;   /* blocks obtained from malloc() at once */
+	long allocs, frees;
+} ltl2ba_PoolStats;
+
+/* A ltl2ba_Stats is zeroed before its first use and may be reused: each
+ * mk_*() overwrites its stage. The other fields count from the start of the
+ * process to the end of the last mk_*(). */
+typedef struct {
+	ltl2ba_Stage alt, gen, buchi;
+	long cache_stores, cache_hits; /* rewrite cache of the formulas */
+	unsigned long mem_total;       /* bytes obtained by tl_emalloc() */
+	/* the blocks of tl_emalloc() by size in words, the larger in sizes[0] */
+	ltl2ba_PoolStats sizes[LTL2BA_POOL_SIZES];
+	ltl2ba_PoolStats atrans, gtrans, btrans;
+} ltl2ba_Stats;
+
+void ltl2ba_free_stats(ltl2ba_Stats *stats); /* frees the passes */
+
+/* Output sink of the printers. The output is gathered in buf and handed in
+ * bulk to the FILE or to the callback when buf is full and on
+ * ltl2ba_writer_flush(). Without either, buf just grows and holds the whole
+ * output (len bytes, null-terminated, NULL if nothing was written) until
+ * ltl2ba_writer_free(). */
+typedef struct ltl2ba_Writer {
+	char *buf;
+	size_t len, cap;
+	FILE *file;
+	void (*write)(void *ctx, const char *data, size_t len);
+	void *ctx;
+} ltl2ba_Writer;
+
+void ltl2ba_writer_buffer(ltl2ba_Writer *w);
+void ltl2ba_writer_file(ltl2ba_Writer *w, FILE *f);
+void ltl2ba_writer_callback(ltl2ba_Writer *w,
+                            void (*write)(void *ctx, const char *data,
+                                          size_t len),
+                            void *ctx);
+void ltl2ba_writer_flush(ltl2ba_Writer *w);
+void ltl2ba_writer_free(ltl2ba_Writer *w); /* flushes and releases buf */
+void ltl2ba_writer_write(ltl2ba_Writer *w, const char *data, size_t len);
+void ltl2ba_writer_puts(ltl2ba_Writer *w, const char *s);
+int  ltl2ba_writer_printf(ltl2ba_Writer *w, const char *fmt, ...)
+#ifdef __GNUC__
+	__attribute__((format(printf, 2, 3)))
+#endif
+	;
+
 ltl2ba_Node *  Canonical(ltl2ba_Symtab symtab, ltl2ba_Node *);
 ltl2ba_Node *  canonical(ltl2ba_Symtab symtab, ltl2ba_Node *);
 ltl2ba_Node *  cached(ltl2ba_Symtab symtab, ltl2ba_Node *);
@@ -167,11 +315,11 @@ ltl2ba_Node *  right_linked(ltl2ba_Node *);
 ltl2ba_Node *  tl_nn(int, ltl2ba_Node *, ltl2ba_Node *);
 
 ltl2ba_Symbol *tl_lookup(ltl2ba_Symtab symtab, const char *);
+void free_symtab(ltl2ba_Symtab symtab);
+void free_cexprtab(ltl2ba_Cexprtab *cexpr);
 
 int            isequal(const ltl2ba_Node *, const ltl2ba_Node *);
 
-void           a_stats(void);
-void           cache_stats(void);
 void           cache_dump(void);
 
 void *         tl_emalloc(int);
@@ -185,27 +333,51 @@ void           free_btrans(ltl2ba_BTrans *, ltl2ba_BTrans *, int);
 void           releasenode(int, ltl2ba_Node *);
 void           tfree(void *);
 
-ltl2ba_Node *  tl_parse(ltl2ba_Symtab symtab, ltl2ba_Cexprtab *cexpr,
-                        ltl2ba_Flags flags);
+/* parses the formula buf[0 .. len-1] in place */
+ltl2ba_Node *  ltl2ba_parse(const char *buf, size_t len, ltl2ba_Symtab symtab,
+                            ltl2ba_Cexprtab *cexpr, ltl2ba_Flags flags);
 
+/* stats may be NULL */
 ltl2ba_Alternating mk_alternating(const ltl2ba_Node *, FILE *,
                                   const ltl2ba_Cexprtab *cexpr,
-                                  ltl2ba_Flags flags);
+                                  ltl2ba_Flags flags, ltl2ba_Stats *stats);
 ltl2ba_Generalized mk_generalized(const ltl2ba_Alternating *, FILE *,
                                   ltl2ba_Flags flags,
-                                  const ltl2ba_Cexprtab *cexpr);
+                                  const ltl2ba_Cexprtab *cexpr,
+                                  ltl2ba_Stats *stats);
+/* does nothing but copy g->status if the generalized automaton is stopped */
 ltl2ba_Buchi mk_buchi(ltl2ba_Generalized *g, FILE *, ltl2ba_Flags,
-                      const char *const *sym_table,
-                      const ltl2ba_Cexprtab *cexpr);
-
-void print_c_buchi(FILE *f, const ltl2ba_Buchi *b, const char *const *sym_table,
-                   const ltl2ba_Cexprtab *cexpr, int sym_id,
-                   const char *c_sym_name_prefix, const char *extern_header,
-                   const char *cmdline);
-void print_dot_buchi(FILE *f, const ltl2ba_Buchi *b,
-                     const char *const *sym_table,
+                      const ltl2ba_Symbol *const *sym_table,
+                      const ltl2ba_Cexprtab *cexpr, ltl2ba_Stats *stats);
+
+/* Only LTL2BA_SIMP_FLY and LTL2BA_FJTOFJ are used by the lazy construction:
+ * the other simplifications need the whole automaton. The transitions of the
+ * alternating automaton must not be freed while the lazy one is in use. The
+ * lazy construction is never stopped: its caller decides when to go on. */
+ltl2ba_Lazy    mk_lazy_buchi(const ltl2ba_Alternating *, ltl2ba_Flags flags);
+ltl2ba_BState *lazy_init_bstate(ltl2ba_Lazy *lz);
+/* returns the sentinel of the list of the transitions from s */
+ltl2ba_BTrans *lazy_bsuccessors(ltl2ba_Lazy *lz, ltl2ba_BState *s);
+
+/* The analysis of the alphabet may stop the C printers: the output is then
+ * truncated. */
+ltl2ba_Status print_c_buchi(ltl2ba_Writer *f, const ltl2ba_Buchi *b,
+                            const ltl2ba_Symbol *const *sym_table,
+                            const ltl2ba_Cexprtab *cexpr, int sym_id,
+                            const char *c_sym_name_prefix,
+                            const char *extern_header, const char *cmdline);
+/* same monitor as print_c_buchi(), driven by constant tables */
+ltl2ba_Status print_c_table_buchi(ltl2ba_Writer *f, const ltl2ba_Buchi *b,
+                                  const ltl2ba_Symbol *const *sym_table,
+                                  const ltl2ba_Cexprtab *cexpr, int sym_id,
+                                  const char *c_sym_name_prefix,
+                                  const char *extern_header,
+                                  const char *cmdline);
+void print_dot_buchi(ltl2ba_Writer *f, const ltl2ba_Buchi *b,
+                     const ltl2ba_Symbol *const *sym_table,
                      const ltl2ba_Cexprtab *cexpr);
-void print_spin_buchi(FILE *f, const ltl2ba_Buchi *b, const char **sym_table);
+void print_spin_buchi(ltl2ba_Writer *f, const ltl2ba_Buchi *b,
+                      const ltl2ba_Symbol *const *sym_table);
 
 ltl2ba_ATrans *merge_trans(const ltl2ba_set_sizes *sz, const ltl2ba_ATrans *,
                            const ltl2ba_ATrans *);
@@ -221,32 +393,31 @@ void do_merge_sets(int *, int *, int *, int);
 int *intersect_sets(int *, int *, int);
 void add_set(int *, int);
 void rem_set(int *, int);
-void spin_print_set(FILE *, const char *const *sym_table, int *, int *,
-                    int sym_size);
-void dot_print_set(FILE *, const char *const *sym_table,
+void spin_print_set(ltl2ba_Writer *, const ltl2ba_Symbol *const *sym_table, int *,
+                    int *, int sym_size);
+void dot_print_set(ltl2ba_Writer *, const ltl2ba_Symbol *const *sym_table,
                    const ltl2ba_Cexprtab *cexpr, int *, int *, int sym_size,
                    int need_parens);
-void c_print_set(FILE *f, const char *const *sym_table, int *pos, int *neg,
-                 int sym_size);
-void print_set(FILE *, int *, int);
+void c_print_set(ltl2ba_Writer *f, const ltl2ba_Symbol *const *sym_table, int *pos,
+                 int *neg, int sym_size);
+void print_set(ltl2ba_Writer *, int *, int);
 int  empty_set(int *, int);
 int  empty_intersect_sets(int *, int *, int);
 int  same_sets(int *, int *, int);
 int  included_set(int *, int *, int);
 int  in_set(int *, int);
+unsigned hash_set(int *, int);
 int *list_set(int *, int);
 
-void print_sym_set(FILE *f, const char *const *sym_table,
+void print_sym_set(ltl2ba_Writer *f, const ltl2ba_Symbol *const *sym_table,
                    const ltl2ba_Cexprtab *cexpr, int *l, int size);
 
 /* implemented by driver (e.g. main.c) */
 void  dump(FILE *, const ltl2ba_Node *);
 char *emalloc(int);
 void  fatal(const char *);
-void  put_uform(FILE *);
+void  put_uform(ltl2ba_Writer *);
 void  tl_explain(int);
-int   tl_Getchar(void);
-void  tl_UnGetchar(void);
 void  tl_yyerror(ltl2ba_Lexer *lex, char *);
 
 #ifdef __cplusplus
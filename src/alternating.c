@@ -8,17 +8,6 @@
 
 #include "internal.h"
 
-/********************************************************************\
-|*              Structures and shared variables                     *|
-\********************************************************************/
-
-struct counts {
-  int astate_count, atrans_count;
-};
-
-static ATrans *build_alternating(const Node *p, const Node **label,
-                                 Alternating *alt);
-
 /********************************************************************\
 |*              Generation of the alternating automaton             *|
 \********************************************************************/
@@ -26,37 +15,60 @@ static ATrans *build_alternating(const Node *p, const Node **label,
 /* returns the number of temporal nodes */
 static int calculate_node_size(const Node *p)
 {
-  switch(p->ntyp) {
-  case AND:
-  case OR:
-  case U_OPER:
-  case V_OPER:
-    return(calculate_node_size(p->lft) + calculate_node_size(p->rgt) + 1);
-  case NEXT:
-    return(calculate_node_size(p->lft) + 1);
-  default:
-    return 1;
-    break;
+  const Node *local[64], **st = local;
+  int sp = 0, size = 64, n = 0;
+
+  st[sp++] = p;
+  while(sp) {
+    p = st[--sp];
+    n++;
+    switch(p->ntyp) {
+    case AND:
+    case OR:
+    case U_OPER:
+    case V_OPER:
+      STACK_PUSH(st, sp, size, local, p->rgt);
+      /* fall through */
+    case NEXT:
+      STACK_PUSH(st, sp, size, local, p->lft);
+      break;
+    default:
+      break;
+    }
   }
+  STACK_FREE(st, local);
+  return n;
 }
 
 /* returns the number of predicates */
 static int calculate_sym_size(const Node *p)
 {
-  switch(p->ntyp) {
-  case AND:
-  case OR:
-  case U_OPER:
-  case V_OPER:
-    return(calculate_sym_size(p->lft) + calculate_sym_size(p->rgt));
-  case NEXT:
-    return(calculate_sym_size(p->lft));
-  case NOT:
-  case PREDICATE:
-    return 1;
-  default:
-    return 0;
+  const Node *local[64], **st = local;
+  int sp = 0, size = 64, n = 0;
+
+  st[sp++] = p;
+  while(sp) {
+    p = st[--sp];
+    switch(p->ntyp) {
+    case AND:
+    case OR:
+    case U_OPER:
+    case V_OPER:
+      STACK_PUSH(st, sp, size, local, p->rgt);
+      /* fall through */
+    case NEXT:
+      STACK_PUSH(st, sp, size, local, p->lft);
+      break;
+    case NOT:
+    case PREDICATE:
+      n++;
+      break;
+    default:
+      break;
+    }
   }
+  STACK_FREE(st, local);
+  return n;
 }
 
 /* returns the copy of a transition */
@@ -110,176 +122,256 @@ static int already_done(const Node *p, const Node *const *label, int node_id)
 }
 
 /* finds the id of a predicate, or attributes one */
-static int get_sym_id(const char *s, Alternating *alt)
+static int get_sym_id(const Symbol *s, Alternating *alt)
 {
   int i;
   for(i=0; i<alt->sym_id; i++)
-    if (!strcmp(s, alt->sym_table[i]))
+    if (s == alt->sym_table[i]) /* symbols are interned by tl_lookup() */
       return i;
   alt->sym_table[alt->sym_id] = s;
   return alt->sym_id++;
 }
 
-/* computes the transitions to boolean nodes -> next & init */
-static ATrans *boolean(const Node *p, const Node **label, Alternating *alt)
+/* returns the transitions of the AND or OR of the transitions lft and rgt */
+static ATrans *combine_trans(const set_sizes *sz, int tok, const ATrans *lft,
+                             const ATrans *rgt)
 {
-  ATrans *t1, *t2, *lft, *rgt, *result = (ATrans *)0;
-  switch(p->ntyp) {
-  case TRUE:
-    result = emalloc_atrans(alt->sz.sym_size, alt->sz.node_size);
-    clear_set(result->to,  alt->sz.node_size);
-    clear_set(result->pos, alt->sz.sym_size);
-    clear_set(result->neg, alt->sz.sym_size);
-  case FALSE:
-    break;
-  case AND:
-    lft = boolean(p->lft, label, alt);
-    rgt = boolean(p->rgt, label, alt);
+  const ATrans *t1, *t2;
+  ATrans *result = (ATrans *)0;
+
+  if(tok == AND) {
     for(t1 = lft; t1; t1 = t1->nxt) {
       for(t2 = rgt; t2; t2 = t2->nxt) {
-	ATrans *tmp = merge_trans(&alt->sz, t1, t2);
+	ATrans *tmp = merge_trans(sz, t1, t2);
 	if(tmp) {
 	  tmp->nxt = result;
 	  result = tmp;
 	}
       }
     }
-    free_atrans(lft, 1);
-    free_atrans(rgt, 1);
-    break;
-  case OR:
-    lft = boolean(p->lft, label, alt);
-    for(t1 = lft; t1; t1 = t1->nxt) {
-      ATrans *tmp = dup_trans(&alt->sz, t1);
-      tmp->nxt = result;
-      result = tmp;
-    }
-    free_atrans(lft, 1);
-    rgt = boolean(p->rgt, label, alt);
-    for(t1 = rgt; t1; t1 = t1->nxt) {
-      ATrans *tmp = dup_trans(&alt->sz, t1);
-      tmp->nxt = result;
-      result = tmp;
-    }
-    free_atrans(rgt, 1);
-    break;
-  default:
-    build_alternating(p, label, alt);
-    result = emalloc_atrans(alt->sz.sym_size, alt->sz.node_size);
-    clear_set(result->to,  alt->sz.node_size);
-    clear_set(result->pos, alt->sz.sym_size);
-    clear_set(result->neg, alt->sz.sym_size);
-    add_set(result->to, already_done(p, label, alt->node_id));
+    return result;
+  }
+  for(t1 = lft; t1; t1 = t1->nxt) {
+    ATrans *tmp = dup_trans(sz, t1);
+    tmp->nxt = result;
+    result = tmp;
+  }
+  for(t1 = rgt; t1; t1 = t1->nxt) {
+    ATrans *tmp = dup_trans(sz, t1);
+    tmp->nxt = result;
+    result = tmp;
   }
   return result;
 }
 
-/* builds an alternating automaton for p */
-static ATrans *build_alternating(const Node *p, const Node **label,
-                                 Alternating *alt)
+/* a transition with no condition and no target */
+static ATrans *true_trans(const Alternating *alt)
 {
-  ATrans *t1, *t2, *t = (ATrans *)0;
-  int node = already_done(p, label, alt->node_id);
-  if(node >= 0) return alt->transition[node];
-
-  switch (p->ntyp) {
-
-  case TRUE:
-    t = emalloc_atrans(alt->sz.sym_size, alt->sz.node_size);
-    clear_set(t->to,  alt->sz.node_size);
-    clear_set(t->pos, alt->sz.sym_size);
-    clear_set(t->neg, alt->sz.sym_size);
-  case FALSE:
-    break;
-
-  case PREDICATE:
-    t = emalloc_atrans(alt->sz.sym_size, alt->sz.node_size);
-    clear_set(t->to,  alt->sz.node_size);
-    clear_set(t->pos, alt->sz.sym_size);
-    clear_set(t->neg, alt->sz.sym_size);
-    add_set(t->pos, get_sym_id(p->sym->name, alt));
-    break;
-
-  case NOT:
-    t = emalloc_atrans(alt->sz.sym_size, alt->sz.node_size);
-    clear_set(t->to,  alt->sz.node_size);
-    clear_set(t->pos, alt->sz.sym_size);
-    clear_set(t->neg, alt->sz.sym_size);
-    add_set(t->neg, get_sym_id(p->lft->sym->name, alt));
-    break;
-
-  case NEXT:
-    t = boolean(p->lft, label, alt);
-    break;
-
-  case U_OPER:    /* p U q <-> q || (p && X (p U q)) */
-    for(t2 = build_alternating(p->rgt, label, alt); t2; t2 = t2->nxt) {
-      ATrans *tmp = dup_trans(&alt->sz, t2);  /* q */
-      tmp->nxt = t;
-      t = tmp;
-    }
-    for(t1 = build_alternating(p->lft, label, alt); t1; t1 = t1->nxt) {
-      ATrans *tmp = dup_trans(&alt->sz, t1);  /* p */
-      add_set(tmp->to, alt->node_id);  /* X (p U q) */
-      tmp->nxt = t;
-      t = tmp;
-    }
-    add_set(alt->final_set, alt->node_id);
-    break;
+  ATrans *t = emalloc_atrans(alt->sz.sym_size, alt->sz.node_size);
+  clear_set(t->to,  alt->sz.node_size);
+  clear_set(t->pos, alt->sz.sym_size);
+  clear_set(t->neg, alt->sz.sym_size);
+  return t;
+}
 
-  case V_OPER:    /* p V q <-> (p && q) || (p && X (p V q)) */
-    for(t1 = build_alternating(p->rgt, label, alt); t1; t1 = t1->nxt) {
-      ATrans *tmp;
+/* gives p the next node id */
+static void record_node(const Node *p, ATrans *t, const Node **label,
+                        Alternating *alt)
+{
+  alt->transition[alt->node_id] = t;
+  label[alt->node_id++] = p;
+}
 
-      for(t2 = build_alternating(p->lft, label, alt); t2; t2 = t2->nxt) {
-	tmp = merge_trans(&alt->sz, t1, t2);  /* p && q */
-	if(tmp) {
-	  tmp->nxt = t;
-	  t = tmp;
-	}
+/* Builds the nodes of p and returns their transitions. With as_boolean set,
+ * p is rather taken as a boolean formula over nodes, as the initial state
+ * and the operand of a NEXT are: the transitions then go to the nodes of
+ * p. The operands of AND, OR, NEXT, U and V wait for the transitions of
+ * their operands on an explicit stack, as the formulas can be deep. */
+static ATrans *build_alternating(const Node *p, int as_boolean,
+                                 const Node **label, Alternating *alt)
+{
+  struct {
+    const Node *p;
+    ATrans *lft;
+    char as_boolean, pc;  /* pc is set once the left operand is done */
+  } local[64], *st = local, *c;
+  int sp = 0, size = 64, node;
+  ATrans *t, *t1, *t2, *tmp;
+
+  for(;;) { /* builds p */
+    if(as_boolean) {
+      switch(p->ntyp) {
+      case TRUE:
+        t = true_trans(alt);
+        break;
+      case FALSE:
+        t = (ATrans *)0;
+        break;
+      case AND:
+      case OR:
+        STACK_RESERVE(st, sp, size, local);
+        st[sp].p = p;
+        st[sp].as_boolean = 1;
+        st[sp++].pc = 0;
+        p = p->lft;
+        continue;
+      default:  /* the transitions go to the node p, built first */
+        STACK_RESERVE(st, sp, size, local);
+        st[sp].p = p;
+        st[sp].as_boolean = 1;
+        st[sp++].pc = 0;
+        as_boolean = 0;
+        continue;
       }
-
-      tmp = dup_trans(&alt->sz, t1);  /* p */
-      add_set(tmp->to, alt->node_id);  /* X (p V q) */
-      tmp->nxt = t;
-      t = tmp;
+    } else if((node = already_done(p, label, alt->node_id)) >= 0)
+      t = alt->transition[node];
+    else {
+      switch(p->ntyp) {
+      case TRUE:
+        t = true_trans(alt);
+        break;
+      case PREDICATE:
+        t = true_trans(alt);
+        add_set(t->pos, get_sym_id(p->sym, alt));
+        break;
+      case NOT:
+        t = true_trans(alt);
+        add_set(t->neg, get_sym_id(p->lft->sym, alt));
+        break;
+      case AND:
+      case OR:
+      case NEXT:
+      case U_OPER:  /* p U q <-> q || (p && X (p U q)) */
+      case V_OPER:  /* p V q <-> (p && q) || (p && X (p V q)) */
+        STACK_RESERVE(st, sp, size, local);
+        st[sp].p = p;
+        st[sp].as_boolean = 0;
+        st[sp++].pc = 0;
+        /* q first for U and V, as a boolean formula for NEXT */
+        as_boolean = p->ntyp == NEXT;
+        p = p->ntyp == U_OPER || p->ntyp == V_OPER ? p->rgt : p->lft;
+        continue;
+      default:
+        t = (ATrans *)0;
+      }
+      record_node(p, t, label, alt);
     }
-    break;
 
-  case AND:
-    t = (ATrans *)0;
-    for(t1 = build_alternating(p->lft, label, alt); t1; t1 = t1->nxt) {
-      for(t2 = build_alternating(p->rgt, label, alt); t2; t2 = t2->nxt) {
-	ATrans *tmp = merge_trans(&alt->sz, t1, t2);
-	if(tmp) {
-	  tmp->nxt = t;
-	  t = tmp;
-	}
+    for(; sp; sp--) { /* the operands waited for */
+      c = &st[sp - 1];
+      if(c->as_boolean) {
+        if(c->p->ntyp != AND && c->p->ntyp != OR) {
+          t = true_trans(alt);
+          add_set(t->to, already_done(c->p, label, alt->node_id));
+          continue;
+        }
+        if(!c->pc) {
+          if(c->p->ntyp == OR) { /* copied before the right operand */
+            t1 = t;
+            t = combine_trans(&alt->sz, OR, t1, (ATrans *)0);
+            free_atrans(t1, 1);
+          }
+          c->lft = t;
+          break;
+        }
+        if(c->p->ntyp == AND) {
+          t1 = t;
+          t = combine_trans(&alt->sz, AND, c->lft, t1);
+          free_atrans(c->lft, 1);
+          free_atrans(t1, 1);
+        } else {
+          t2 = c->lft;
+          for(t1 = t; t1; t1 = t1->nxt) {
+            tmp = dup_trans(&alt->sz, t1);
+            tmp->nxt = t2;
+            t2 = tmp;
+          }
+          free_atrans(t, 1);
+          t = t2;
+        }
+        continue;
       }
+      switch(c->p->ntyp) {
+      case AND:
+      case OR:
+        if(!c->pc) {
+          c->lft = t;
+          if(t || c->p->ntyp == OR)
+            break; /* the right operand is needed */
+        } else
+          t = combine_trans(&alt->sz, c->p->ntyp, c->lft, t);
+        record_node(c->p, t, label, alt);
+        continue;
+      case NEXT:
+        record_node(c->p, t, label, alt);
+        continue;
+      case U_OPER:
+        if(!c->pc) {
+          c->lft = t;
+          break;
+        }
+        t2 = (ATrans *)0;
+        for(t1 = c->lft; t1; t1 = t1->nxt) {
+          tmp = dup_trans(&alt->sz, t1);  /* q */
+          tmp->nxt = t2;
+          t2 = tmp;
+        }
+        for(t1 = t; t1; t1 = t1->nxt) {
+          tmp = dup_trans(&alt->sz, t1);  /* p */
+          add_set(tmp->to, alt->node_id);  /* X (p U q) */
+          tmp->nxt = t2;
+          t2 = tmp;
+        }
+        add_set(alt->final_set, alt->node_id);
+        record_node(c->p, t2, label, alt);
+        t = t2;
+        continue;
+      case V_OPER:
+        if(!c->pc) {
+          c->lft = t;
+          if(t)
+            break; /* p is only needed with some q */
+          record_node(c->p, t, label, alt);
+          continue;
+        }
+        t2 = (ATrans *)0;
+        for(t1 = c->lft; t1; t1 = t1->nxt) {
+          ATrans *t3;
+
+          /* p is looked up again for the next q: AND and OR being compared
+           * as sets, one of its operands may be found first */
+          if(t1 != c->lft)
+            t = alt->transition[already_done(c->p->lft, label, alt->node_id)];
+          for(t3 = t; t3; t3 = t3->nxt) {
+            tmp = merge_trans(&alt->sz, t1, t3);  /* p && q */
+            if(tmp) {
+              tmp->nxt = t2;
+              t2 = tmp;
+            }
+          }
+
+          tmp = dup_trans(&alt->sz, t1);  /* p */
+          add_set(tmp->to, alt->node_id);  /* X (p V q) */
+          tmp->nxt = t2;
+          t2 = tmp;
+        }
+        record_node(c->p, t2, label, alt);
+        t = t2;
+        continue;
+      }
+      break;
     }
-    break;
-
-  case OR:
-    t = (ATrans *)0;
-    for(t1 = build_alternating(p->lft, label, alt); t1; t1 = t1->nxt) {
-      ATrans *tmp = dup_trans(&alt->sz, t1);
-      tmp->nxt = t;
-      t = tmp;
-    }
-    for(t1 = build_alternating(p->rgt, label, alt); t1; t1 = t1->nxt) {
-      ATrans *tmp = dup_trans(&alt->sz, t1);
-      tmp->nxt = t;
-      t = tmp;
-    }
-    break;
-
-  default:
-    break;
+    if(!sp)
+      break;
+    /* the other operand of the node waiting: p of U and V, the right one
+     * of AND and OR */
+    c = &st[sp - 1];
+    c->pc = 1;
+    as_boolean = c->as_boolean;
+    p = c->p->ntyp == U_OPER || c->p->ntyp == V_OPER ? c->p->lft : c->p->rgt;
   }
-
-  alt->transition[alt->node_id] = t;
-  label[alt->node_id++] = p;
-  return(t);
+  STACK_FREE(st, local);
+  return t;
 }
 
 /********************************************************************\
@@ -287,8 +379,7 @@ static ATrans *build_alternating(const Node *p, const Node **label,
 \********************************************************************/
 
 /* simplifies the transitions */
-static void simplify_atrans(const Alternating *alt, ATrans **trans,
-                            struct counts *c)
+static void simplify_atrans(const Alternating *alt, ATrans **trans)
 {
   ATrans *t, *father = (ATrans *)0;
   for(t = *trans; t;) {
@@ -312,15 +403,13 @@ static void simplify_atrans(const Alternating *alt, ATrans **trans,
 	t = *trans;
       continue;
     }
-    c->atrans_count++;
     father = t;
     t = t->nxt;
   }
 }
 
 /* simplifies the alternating automaton */
-static void simplify_astates(const Node **label, Alternating *alt,
-                             struct counts *c)
+static void simplify_astates(const Node **label, Alternating *alt)
 {
   ATrans *t;
   int i, *acc = make_set(-1, alt->sz.node_size); /* no state is accessible initially */
@@ -335,8 +424,7 @@ static void simplify_astates(const Node **label, Alternating *alt,
       alt->transition[i] = (ATrans *)0;
       continue;
     }
-    c->astate_count++;
-    simplify_atrans(alt, &alt->transition[i], c);
+    simplify_atrans(alt, &alt->transition[i]);
     for(t = alt->transition[i]; t; t = t->nxt)
       merge_sets(acc, t->to, alt->sz.node_size);
   }
@@ -349,34 +437,35 @@ static void simplify_astates(const Node **label, Alternating *alt,
 \********************************************************************/
 
 /* dumps the alternating automaton */
-static void print_alternating(FILE *f, const Node **label,
+static void print_alternating(Writer *f, const Node **label,
                               const Cexprtab *cexpr, const Alternating *alt)
 {
   int i;
   ATrans *t;
 
-  fprintf(f, "init :\n");
+  w_printf(f, "init :\n");
   for(t = alt->transition[0]; t; t = t->nxt) {
     print_set(f, t->to, alt->sz.node_size);
-    fprintf(f, "\n");
+    w_printf(f, "\n");
   }
 
   for(i = alt->node_id - 1; i > 0; i--) {
     if(!label[i])
       continue;
-    fprintf(f, "state %i : ", i);
-    dump(f, label[i]);
-    fprintf(f, "\n");
+    w_printf(f, "state %i : ", i);
+    ltl2ba_writer_flush(f); /* dump() writes to the file itself */
+    dump(f->file, label[i]);
+    w_printf(f, "\n");
     for(t = alt->transition[i]; t; t = t->nxt) {
       if (empty_set(t->pos, alt->sz.sym_size) && empty_set(t->neg, alt->sz.sym_size))
-	fprintf(f, "1");
+	w_printf(f, "1");
       print_sym_set(f, alt->sym_table, cexpr, t->pos, alt->sz.sym_size);
       if (!empty_set(t->pos,alt->sz.sym_size) && !empty_set(t->neg,alt->sz.sym_size))
-        fprintf(f, " & ");
+        w_printf(f, " & ");
       print_sym_set(f, alt->sym_table, cexpr, t->neg, alt->sz.sym_size);
-      fprintf(f, " -> ");
+      w_printf(f, " -> ");
       print_set(f, t->to, alt->sz.node_size);
-      fprintf(f, "\n");
+      w_printf(f, "\n");
     }
   }
 }
@@ -385,20 +474,38 @@ static void print_alternating(FILE *f, const Node **label,
 |*                       Main method                                *|
 \********************************************************************/
 
+/* counts the states (but the initial one) and their transitions */
+static void count_astates(const Node **label, const Alternating *alt,
+                          int *states, int *trans)
+{
+  ATrans *t;
+  int i;
+
+  *states = *trans = 0;
+  for(i = alt->node_id - 1; i > 0; i--) {
+    if(!label[i])
+      continue;
+    (*states)++;
+    for(t = alt->transition[i]; t; t = t->nxt)
+      (*trans)++;
+  }
+}
+
 /* generates an alternating automaton for p */
 Alternating mk_alternating(const Node *p, FILE *tl_out, const Cexprtab *cexpr,
-                           Flags flags)
+                           Flags flags, Stats *stats)
 {
-  struct counts cnts;
-  memset(&cnts, 0, sizeof(cnts));
-  struct rusage tr_debut, tr_fin;
-  struct timeval t_diff;
+  StatsClock stage, pass;
+  Pass *ps = NULL;
   Alternating alt;
   memset(&alt, 0, sizeof(alt));
   alt.node_id = 1;
   alt.sym_id = 0;
 
-  if(flags & LTL2BA_STATS) getrusage(RUSAGE_SELF, &tr_debut);
+  if(stats) {
+    stats_stage(&stats->alt);
+    stats_start(&stage);
+  }
 
   int the_node_size = calculate_node_size(p) + 1; /* number of states in the automaton */
   const Node **label = tl_emalloc(the_node_size * sizeof(Node *));
@@ -406,31 +513,49 @@ Alternating mk_alternating(const Node *p, FILE *tl_out, const Cexprtab *cexpr,
   alt.sz.node_size = LTL2BA_SET_SIZE(the_node_size);
 
   int the_sym_size = calculate_sym_size(p); /* number of predicates */
-  if(the_sym_size) alt.sym_table = tl_emalloc(the_sym_size * sizeof(char *));
+  if(the_sym_size) alt.sym_table = tl_emalloc(the_sym_size * sizeof(Symbol *));
   alt.sz.sym_size = LTL2BA_SET_SIZE(the_sym_size);
 
   alt.final_set = make_set(-1, alt.sz.node_size);
-  alt.transition[0] = boolean(p, label, &alt); /* generates the alternating automaton */
+  alt.transition[0] = build_alternating(p, 1, label, &alt); /* generates the alternating automaton */
+
+  if(stats) {
+    stats_stop(&stage, &stats->alt.build);
+    count_astates(label, &alt, &stats->alt.states, &stats->alt.trans);
+  }
 
   if(flags & LTL2BA_VERBOSE) {
+    Writer w;
     fprintf(tl_out, "\nAlternating automaton before simplification\n");
-    print_alternating(tl_out, label, cexpr, &alt);
+    ltl2ba_writer_file(&w, tl_out);
+    print_alternating(&w, label, cexpr, &alt);
+    ltl2ba_writer_free(&w);
   }
 
   if(flags & LTL2BA_SIMP_DIFF) {
-    simplify_astates(label, &alt, &cnts); /* keeps only accessible states */
+    if(stats) {
+      ps = stats_pass(&stats->alt, LTL2BA_PASS_ASTATES);
+      ps->states_before = stats->alt.states;
+      ps->trans_before = stats->alt.trans;
+      stats_start(&pass);
+    }
+    simplify_astates(label, &alt); /* keeps only accessible states */
+    if(stats) {
+      stats_stop(&pass, &ps->time);
+      count_astates(label, &alt, &ps->states_after, &ps->trans_after);
+    }
     if(flags & LTL2BA_VERBOSE) {
+      Writer w;
       fprintf(tl_out, "\nAlternating automaton after simplification\n");
-      print_alternating(tl_out, label, cexpr, &alt);
+      ltl2ba_writer_file(&w, tl_out);
+      print_alternating(&w, label, cexpr, &alt);
+      ltl2ba_writer_free(&w);
     }
   }
 
-  if(flags & LTL2BA_STATS) {
-    getrusage(RUSAGE_SELF, &tr_fin);
-    timeval_subtract (&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
-    fprintf(tl_out, "\nBuilding and simplification of the alternating automaton: %ld.%06lis",
-		t_diff.tv_sec, t_diff.tv_usec);
-    fprintf(tl_out, "\n%i states, %i transitions\n", cnts.astate_count, cnts.atrans_count);
+  if(stats) {
+    stats_stop(&stage, &stats->alt.time);
+    stats_memory(stats);
   }
 
   tfree(label);
@@ -8,53 +8,104 @@
 
 #include "internal.h"
 
-#undef min
-#define min(x,y)        ((x<y)?x:y)
+#include <pthread.h>
+#include <unistd.h>
 
 /********************************************************************\
 |*              Structures and shared variables                     *|
 \********************************************************************/
 
-typedef struct BScc {
-  BState *bstate;
-  int rank;
-  int theta;
-  struct BScc *nxt;
-} BScc;
-
-struct bdfs_state {
-  int rank;
-  BScc *scc_stack;
-};
+typedef struct Slist {
+  int * set;
+  unsigned hash; /* hash_set() of set */
+  struct Slist * nxt; } Slist;
 
-struct bcounts {
-  int bstate_count, btrans_count;
+/* Partial valuation of the symbols: the letters it covers are those
+ * containing the symbols of 'tru' and none of those of 'fls'. */
+typedef struct Cube {
+  int *tru, *fls;
+  struct Cube *nxt;
+} Cube;
+
+/* Decision tree mapping letters to their class: an inner node tests the
+ * symbol 'sym', a leaf (sym == -1) gives the class 'cls'. */
+typedef struct LNode {
+  int sym, cls;
+  struct LNode *lo, *hi;
+} LNode;
+
+/* Partition of the letters into classes of letters enabling the same
+ * transitions, numbered by increasing smallest letter. */
+struct letter_classes {
+  int count, size;
+  int **sig;    /* guards enabled by the letters of each class */
+  int **rep;    /* smallest letter of each class */
+  Cube **cubes; /* cubes covering each class */
+  LNode *tree;
+  /* while the classes are built: */
+  Cube **last;     /* last cube of each class */
+  unsigned *hash;  /* hash_set() of the guards of each class */
+  int *slot, hmask; /* classes by hash, open addressing */
 };
 
 /* Record of what states stutter-accept, according to each input symbol. */
 struct accept_sets {
-  int **stutter_accept_table;
+  struct letter_classes classes;
+  int **stutter_accept_table; /* indexed by letter class */
   int *optimistic_accept_state_set;
   int *pessimistic_accept_state_set;
 };
 
-typedef struct Slist {
-  int * set;
-  struct Slist * nxt; } Slist;
-
-struct pess_data {
-  int state_count;
-  int state_size;
-  int *full_state_set;
-  Slist **tr;
-};
-
 /********************************************************************\
 |*        Simplification of the generalized Buchi automaton         *|
 \********************************************************************/
 
+/* adds t, a transition from s, to the list of the transitions to t->to */
+static void link_btrans(BState *s, BTrans *t)
+{
+  t->from = s;
+  t->in_prv = (BTrans *)0;
+  t->in_nxt = t->to->in;
+  if(t->in_nxt) t->in_nxt->in_prv = t;
+  t->to->in = t;
+}
+
+/* removes t from the list of the transitions to t->to */
+static void unlink_btrans(BTrans *t)
+{
+  if(t->in_prv) t->in_prv->in_nxt = t->in_nxt;
+  else t->to->in = t->in_nxt;
+  if(t->in_nxt) t->in_nxt->in_prv = t->in_prv;
+}
+
+static void unlink_all_btrans(BState *s)
+{
+  BTrans *t;
+  for(t = s->trans->nxt; t != s->trans; t = t->nxt)
+    unlink_btrans(t);
+}
+
+/* removes the transition t from s, by moving the next one into t */
+static void delete_btrans(const set_sizes *sz, BState *s, BTrans *t)
+{
+  BTrans *free = t->nxt;
+  unlink_btrans(t);
+  t->to = free->to;
+  copy_set(free->pos, t->pos, sz->sym_size);
+  copy_set(free->neg, t->neg, sz->sym_size);
+  t->nxt = free->nxt;
+  if(free == s->trans)
+    s->trans = t; /* t is the new sentinel */
+  else {
+    unlink_btrans(free);
+    link_btrans(s, t);
+  }
+  free_btrans(free, 0, 0);
+}
+
 static void free_bstate(BState *s) /* frees a state and its transitions */
 {
+  unlink_all_btrans(s);
   free_btrans(s->trans->nxt, s->trans, 1);
   tfree(s);
 }
@@ -65,35 +116,85 @@ static BState *remove_bstate(BState *s, BState *s1, BState *const bremoved)
   BState *prv = s->prv;
   s->prv->nxt = s->nxt;
   s->nxt->prv = s->prv;
+  unlink_all_btrans(s);
   free_btrans(s->trans->nxt, s->trans, 0);
   s->trans = (BTrans *)0;
   s->nxt = bremoved->nxt;
   bremoved->nxt = s;
-  s->prv = s1;
-  for(s1 = bremoved->nxt; s1 != bremoved; s1 = s1->nxt)
-    if(s1->prv == s)
-      s1->prv = s->prv;
+  s->prv = s1; /* s is now represented by s1, see bstate_rep() */
   return prv;
 }
 
+/* returns the state that replaces the removed state s (or s itself if it is
+ * not removed), or 0 if s was removed without replacement; 'prv' links the
+ * removed states to their replacement as a union-find with path compression */
+static BState *bstate_rep(BState *s)
+{
+  BState *r, *nxt;
+  for(r = s; r && !r->trans; r = r->prv)
+    ;
+  for(; s != r; s = nxt) {
+    nxt = s->prv;
+    s->prv = r;
+  }
+  return r;
+}
+
 static void copy_btrans(const set_sizes *sz, BTrans *from, BTrans *to) {
   to->to    = from->to;
   copy_set(from->pos, to->pos, sz->sym_size);
   copy_set(from->neg, to->neg, sz->sym_size);
 }
 
+/* counts the states and the transitions */
+static void count_bstates(const Buchi *b, int *states, int *trans)
+{
+  BState *s;
+  BTrans *t;
+
+  *states = *trans = 0;
+  for(s = b->bstates->nxt; s != b->bstates; s = s->nxt) {
+    (*states)++;
+    for(t = s->trans->nxt; t != s->trans; t = t->nxt)
+      (*trans)++;
+  }
+}
+
+/* starts the measure of a simplification pass, if st is not NULL */
+static Pass *bpass_start(const Buchi *b, Stage *st, ltl2ba_PassKind kind,
+                         StatsClock *c)
+{
+  Pass *p;
+
+  if(!st)
+    return NULL;
+  p = stats_pass(st, kind);
+  count_bstates(b, &p->states_before, &p->trans_before);
+  stats_start(c);
+  return p;
+}
+
+static void bpass_stop(const Buchi *b, Pass *p, const StatsClock *c)
+{
+  if(!p)
+    return;
+  stats_stop(c, &p->time);
+  count_bstates(b, &p->states_after, &p->trans_after);
+}
+
 /* simplifies the transitions */
-static int simplify_btrans(Buchi *b, FILE *f, Flags flags)
+static int simplify_btrans(Buchi *b, Stage *st)
 {
   BState *s;
   BTrans *t, *t1;
   int changed = 0;
-  struct rusage tr_debut, tr_fin;
-  struct timeval t_diff;
-
-  if(flags & LTL2BA_STATS) getrusage(RUSAGE_SELF, &tr_debut);
+  StatsClock c;
+  Pass *p = bpass_start(b, st, LTL2BA_PASS_BTRANS, &c);
 
-  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
+  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt) {
+    if(!(s->dirty & DIRTY_TRANS))
+      continue; /* its transitions did not change since last time */
+    s->dirty &= ~DIRTY_TRANS;
     for (t = s->trans->nxt; t != s->trans;) {
       t1 = s->trans->nxt;
       copy_btrans(&b->sz, t, s->trans);
@@ -102,27 +203,16 @@ static int simplify_btrans(Buchi *b, FILE *f, Flags flags)
             !included_set(t1->neg, t->neg, b->sz.sym_size))
         t1 = t1->nxt;
       if(t1 != s->trans) {
-        BTrans *free = t->nxt;
-        t->to    = free->to;
-        copy_set(free->pos, t->pos, b->sz.sym_size);
-        copy_set(free->neg, t->neg, b->sz.sym_size);
-        t->nxt   = free->nxt;
-        if(free == s->trans) s->trans = t;
-        free_btrans(free, 0, 0);
+        delete_btrans(&b->sz, s, t);
+        s->dirty |= DIRTY_STATES;
         changed++;
       }
       else
         t = t->nxt;
     }
-
-  if(flags & LTL2BA_STATS) {
-    getrusage(RUSAGE_SELF, &tr_fin);
-    timeval_subtract (&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
-    fprintf(f, "\nSimplification of the Buchi automaton - transitions: %ld.%06lis",
-		t_diff.tv_sec, t_diff.tv_usec);
-    fprintf(f, "\n%i transitions removed\n", changed);
-
   }
+
+  bpass_stop(b, p, &c);
   return changed;
 }
 
@@ -134,22 +224,14 @@ static int same_btrans(const set_sizes *sz, BTrans *s, BTrans *t)
 	 same_sets(s->neg, t->neg, sz->sym_size));
 }
 
-/* redirects transitions before removing a state from the automaton */
+/* removes the transitions to a state with no transitions */
 static void remove_btrans(Buchi *b, BState *to)
 {
-  BState *s;
   BTrans *t;
-  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
-    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
-      if (t->to == to) { /* transition to a state with no transitions */
-	BTrans *free = t->nxt;
-	t->to = free->to;
-	copy_set(free->pos, t->pos, b->sz.sym_size);
-	copy_set(free->neg, t->neg, b->sz.sym_size);
-	t->nxt   = free->nxt;
-	if(free == s->trans) s->trans = t;
-	free_btrans(free, 0, 0);
-      }
+  while((t = to->in)) {
+    t->from->dirty |= DIRTY_TRANS | DIRTY_STATES;
+    delete_btrans(&b->sz, t->from, t);
+  }
 }
 
 /* redirects transitions before removing a state from the automaton */
@@ -157,20 +239,19 @@ static void retarget_all_btrans(Buchi *b, BState *const bremoved)
 {
   BState *s;
   BTrans *t;
-  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
-    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
-      if (!t->to->trans) { /* t->to has been removed */
-	t->to = t->to->prv;
-	if(!t->to) { /* t->to has no transitions */
-	  BTrans *free = t->nxt;
-	  t->to = free->to;
-	  copy_set(free->pos, t->pos, b->sz.sym_size);
-	  copy_set(free->neg, t->neg, b->sz.sym_size);
-	  t->nxt   = free->nxt;
-	  if(free == s->trans) s->trans = t;
-	  free_btrans(free, 0, 0);
-	}
-      }
+  for (s = bremoved->nxt; s != bremoved; s = s->nxt) {
+    BState *rep = bstate_rep(s);
+    if(!rep) { /* s had no transitions */
+      remove_btrans(b, s);
+      continue;
+    }
+    while((t = s->in)) { /* t is a transition to the removed state s */
+      t->from->dirty |= DIRTY_TRANS | DIRTY_STATES;
+      unlink_btrans(t);
+      t->to = rep;
+      link_btrans(t->from, t);
+    }
+  }
   while(bremoved->nxt != bremoved) { /* clean the 'removed' list */
     s = bremoved->nxt;
     bremoved->nxt = bremoved->nxt->nxt;
@@ -214,28 +295,66 @@ static int all_btrans_match(Buchi *buchi, BState *a, BState *b)
   return 1;
 }
 
-/* eliminates redundant states */
-static int simplify_bstates(Buchi *b, FILE *f, Flags flags, int *gstate_id,
-                            BState *const bremoved)
+/* puts s1, which changed during the current pass, in the worklist */
+static void push_worklist(BState *const bstates, BState **wl, int *nwl, int k,
+                          BState *s1)
 {
-  BState *s, *s1, *s2;
-  int changed = 0;
-  struct rusage tr_debut, tr_fin;
-  struct timeval t_diff;
+  BState *x;
+  int j;
+  if(s1->dirty & DIRTY_SCAN) return; /* already there */
+  s1->dirty |= DIRTY_SCAN;
+  for(x = s1->nxt; x != bstates && !(x->dirty & DIRTY_SCAN); x = x->nxt)
+    ; /* the next state of the worklist */
+  for(j = k; j < *nwl && wl[j] != x; j++)
+    ;
+  memmove(&wl[j + 1], &wl[j], (*nwl - j) * sizeof(BState *));
+  wl[j] = s1;
+  (*nwl)++;
+}
 
-  if(flags & LTL2BA_STATS) getrusage(RUSAGE_SELF, &tr_debut);
+/* eliminates redundant states */
+static int simplify_bstates(Buchi *b, int *gstate_id, BState *const bremoved,
+                            Stage *st)
+{
+  BState *s, *s1, *s2, **wl;
+  int changed = 0, nwl = 0, i, k = 0;
+  StatsClock c;
+  Pass *p = bpass_start(b, st, LTL2BA_PASS_BSTATES, &c);
+
+  /* Two states that did not change since the previous pass have already
+   * been compared and did not match: only the pairs involving a state of
+   * the worklist 'wl' (in the order of the list of states) are tried. */
+  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
+    nwl++;
+  wl = (BState **)tl_emalloc((nwl + 1) * sizeof(BState *));
+  nwl = 0;
+  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
+    if(s->dirty & DIRTY_STATES) {
+      s->dirty = (s->dirty & ~DIRTY_STATES) | DIRTY_SCAN;
+      wl[nwl++] = s;
+    }
 
   for (s = b->bstates->nxt; s != b->bstates; s = s->nxt) {
+    while(k < nwl && (wl[k] == s || !wl[k]->trans))
+      k++; /* wl[k..] are now the states of the worklist after s */
     if(s->trans == s->trans->nxt) { /* s has no transitions */
       s = remove_bstate(s, (BState *)0, bremoved);
       changed++;
       continue;
     }
-    b->bstates->trans = s->trans;
-    b->bstates->final = s->final;
-    s1 = s->nxt;
-    while(!all_btrans_match(b, s, s1))
-      s1 = s1->nxt;
+    if(s->dirty & DIRTY_SCAN) { /* compares s with all the states after it */
+      b->bstates->trans = s->trans;
+      b->bstates->final = s->final;
+      s1 = s->nxt;
+      while(!all_btrans_match(b, s, s1))
+        s1 = s1->nxt;
+    }
+    else { /* compares s with the states of the worklist after it */
+      for(i = k; i < nwl; i++)
+        if(wl[i]->trans && all_btrans_match(b, s, wl[i]))
+          break;
+      s1 = (i < nwl) ? wl[i] : b->bstates;
+    }
     if(s1 != b->bstates) { /* s and s1 are equivalent */
       /* we now want to remove s and replace it by s1 */
       if(s1->incoming == -1) {  /* s1 is in a trivial SCC */
@@ -264,11 +383,17 @@ static int simplify_bstates(Buchi *b, FILE *f, Flags flags, int *gstate_id,
          * which correctly handles the first two cases above.
          */
         s1->incoming = s->incoming;
+
+        /* s1 may now match states it did not match before */
+        s1->dirty |= DIRTY_STATES | DIRTY_FINAL;
+        push_worklist(b->bstates, wl, &nwl, k, s1);
       }
       s = remove_bstate(s, s1, bremoved);
       changed++;
     }
   }
+  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
+    s->dirty &= ~DIRTY_SCAN;
   retarget_all_btrans(b, bremoved);
 
   /*
@@ -279,89 +404,131 @@ static int simplify_bstates(Buchi *b, FILE *f, Flags flags, int *gstate_id,
    * We iterate over all states and assign new ids (previously unassigned)
    * to these states to disambiguate.
    * Fix from ltl3ba.
+   * Only pairs involving a state whose final value changed may match.
    */
+  nwl = k = 0;
+  for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
+    if(s->dirty & DIRTY_FINAL)
+      wl[nwl++] = s;
   for (s = b->bstates->nxt; s != b->bstates; s = s->nxt) { /* For all states s*/
-    for (s2 = s->nxt; s2 != b->bstates; s2 = s2->nxt) {    /* and states s2 to the right of s */
-      if(s->final == s2->final && s->id == s2->id) {       /* if final and id match */
-        s->id = ++*gstate_id;                              /* disambiguate by assigning unused id */
+    if(k < nwl && wl[k] == s)
+      k++;
+    if(s->dirty & DIRTY_FINAL) {
+      for (s2 = s->nxt; s2 != b->bstates; s2 = s2->nxt) {  /* and states s2 to the right of s */
+        if(s->final == s2->final && s->id == s2->id) {     /* if final and id match */
+          s->id = ++*gstate_id;                            /* disambiguate by assigning unused id */
+        }
+      }
+    }
+    else {
+      for (i = k; i < nwl; i++) {
+        s2 = wl[i];
+        if(s->final == s2->final && s->id == s2->id)
+          s->id = ++*gstate_id;
       }
     }
   }
+  for (i = 0; i < nwl; i++)
+    wl[i]->dirty &= ~DIRTY_FINAL;
+  tfree(wl);
 
-  if(flags & LTL2BA_STATS) {
-    getrusage(RUSAGE_SELF, &tr_fin);
-    timeval_subtract (&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
-    fprintf(f, "\nSimplification of the Buchi automaton - states: %ld.%06lis",
-		t_diff.tv_sec, t_diff.tv_usec);
-    fprintf(f, "\n%i states removed\n", changed);
-  }
-
+  bpass_stop(b, p, &c);
   return changed;
 }
 
-static int bdfs(BState *s, struct bdfs_state *st) {
+static void simplify_bscc(Buchi *b, BState *const bremoved, Stage *st) {
+  BState *s;
   BTrans *t;
-  BScc *c;
-  BScc *scc = (BScc *)tl_emalloc(sizeof(BScc));
-  scc->bstate = s;
-  scc->rank = st->rank;
-  scc->theta = st->rank++;
-  scc->nxt = st->scc_stack;
-  st->scc_stack = scc;
+  int n = 0, e = 0, root, *off, *succ, *scc, *scc_count, *old;
+  SccWork w;
+  StatsClock c;
+  Pass *p;
 
-  s->incoming = 1;
+  if(b->bstates == b->bstates->nxt) return;
+  p = bpass_start(b, st, LTL2BA_PASS_BSCC, &c);
 
-  for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
-    if (t->to->incoming == 0) {
-      int result = bdfs(t->to, st);
-      scc->theta = min(scc->theta, result);
-    }
-    else {
-      for(c = st->scc_stack->nxt; c != 0; c = c->nxt)
-	if(c->bstate == t->to) {
-	  scc->theta = min(scc->theta, c->rank);
-	  break;
-	}
-    }
-  }
-  if(scc->rank == scc->theta) {
-    if(st->scc_stack == scc) { /* s is alone in a scc */
-      s->incoming = -1;
-      for (t = s->trans->nxt; t != s->trans; t = t->nxt)
-	if (t->to == s)
-	  s->incoming = 1;
-    }
-    st->scc_stack = scc->nxt;
+  for(s = b->bstates->nxt; s != b->bstates; s = s->nxt) {
+    n++;
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
+      e++;
   }
-  return scc->theta;
-}
-
 
-static void simplify_bscc(Buchi *b, BState *const bremoved) {
-  BState *s;
-  struct bdfs_state st;
-  st.rank = 1;
-  st.scc_stack = NULL;
+  off       = (int *)tl_emalloc((n + 1) * sizeof(int));
+  succ      = (int *)tl_emalloc((e + 1) * sizeof(int));
+  scc       = (int *)tl_emalloc((n + 1) * sizeof(int));
+  scc_count = (int *)tl_emalloc((n + 1) * sizeof(int));
+  old       = (int *)tl_emalloc((n + 1) * sizeof(int));
+  for(s = b->bstates->nxt, n = 0; s != b->bstates; s = s->nxt) {
+    old[n] = s->incoming;
+    s->incoming = n++; /* temporarily numbers the states */
+  }
+  for(s = b->bstates->nxt, e = 0; s != b->bstates; s = s->nxt) {
+    off[s->incoming] = e;
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
+      succ[e++] = t->to->incoming;
+  }
+  off[n] = e;
+  root = b->bstates->prv->incoming;
 
-  if(b->bstates == b->bstates->nxt) return;
+  scc_work_init(&w, n);
+  scc_tarjan(&w, n, off, succ, &root, 1, scc);
+  scc_work_free(&w);
 
   for(s = b->bstates->nxt; s != b->bstates; s = s->nxt)
-    s->incoming = 0; /* state color = white */
+    if(scc[s->incoming] >= 0)
+      scc_count[scc[s->incoming]]++;
+
+  for(s = b->bstates->nxt; s != b->bstates; s = s->nxt) {
+    int v = s->incoming;
+    if(scc[v] < 0)
+      s->incoming = 0; /* not reachable */
+    else if(scc_count[scc[v]] > 1)
+      s->incoming = 1;
+    else { /* s is alone in a scc */
+      s->incoming = -1;
+      for (e = off[v]; e < off[v + 1]; e++)
+        if (succ[e] == v)
+          s->incoming = 1;
+    }
+    if((old[v] == -1) != (s->incoming == -1))
+      s->dirty |= DIRTY_STATES; /* its scc became trivial or non-trivial */
+  }
 
-  bdfs(b->bstates->prv, &st);
+  tfree(off);
+  tfree(succ);
+  tfree(scc);
+  tfree(scc_count);
+  tfree(old);
 
   for(s = b->bstates->nxt; s != b->bstates; s = s->nxt)
     if(s->incoming == 0)
-      remove_bstate(s, 0, bremoved);
+      s = remove_bstate(s, 0, bremoved);
+  bpass_stop(b, p, &c);
 }
 
 
-
-
 /********************************************************************\
 |*              Generation of the Buchi automaton                   *|
 \********************************************************************/
 
+/* The states to solve are kept in a stack, doubly linked so that the lazy
+ * construction can take out any of them. */
+static void push_bstate(BState *s, BState *const bstack)
+{
+  s->dirty = DIRTY_PENDING;
+  s->nxt = bstack->nxt;
+  s->prv = bstack;
+  s->nxt->prv = s;
+  bstack->nxt = s;
+}
+
+static void pop_bstate(BState *s)
+{
+  s->prv->nxt = s->nxt;
+  s->nxt->prv = s->prv;
+  s->dirty &= ~DIRTY_PENDING;
+}
+
 /* finds the corresponding state, or creates it */
 static BState *find_bstate(Buchi *b, GState **state, int final, BState *s,
                            BState *const bstack, BState *const bremoved)
@@ -396,8 +563,7 @@ static BState *find_bstate(Buchi *b, GState **state, int final, BState *s,
   s->final = final;
   s->trans = emalloc_btrans(b->sz.sym_size); /* sentinel */
   s->trans->nxt = s->trans;
-  s->nxt = bstack->nxt;
-  bstack->nxt = s;
+  push_bstate(s, bstack);
   return s;
 }
 
@@ -408,34 +574,34 @@ static int next_final(Buchi *b, int *set, int fin, const int *final) /* computes
   return fin;
 }
 
-/* creates all the transitions from a state */
+/* creates all the transitions from a state, unless the translation is
+ * stopped: *stop then tells why (never stopped if stop is NULL) */
 static void make_btrans(Buchi *b, BState *s, const int *final, Flags flags,
-                        struct bcounts *c, BState *const bstack,
-                        BState *const bremoved)
+                        BState *const bstack, BState *const bremoved,
+                        Status *stop)
 {
-  int state_trans = 0;
   GTrans *t;
   BTrans *t1;
   BState *s1;
-  if(s->gstate->trans)
-    for(t = s->gstate->trans->nxt; t != s->gstate->trans; t = t->nxt) {
+  GState *gs = gstate_rep(s->gstate);
+  if(gs)
+    for(t = gs->trans->nxt; t != gs->trans; t = t->nxt) {
       int fin = next_final(b, t->final, (s->final == b->accept) ? 0 : s->final, final);
-      BState *to = find_bstate(b, &t->to, fin, s, bstack, bremoved);
+      GState *gto = gstate_rep(t->to); /* t->to may be removed in a lazy automaton */
+      BState *to;
+      if(stop && (*stop = check_stop()))
+        return;
+      if(!gto)
+        continue;
+      to = find_bstate(b, &gto, fin, s, bstack, bremoved);
 
       for(t1 = s->trans->nxt; t1 != s->trans;) {
 	if((flags & LTL2BA_SIMP_FLY) &&
 	   (to == t1->to) &&
 	   included_set(t->pos, t1->pos, b->sz.sym_size) &&
 	   included_set(t->neg, t1->neg, b->sz.sym_size)) { /* t1 is redondant */
-	  BTrans *free = t1->nxt;
 	  t1->to->incoming--;
-	  t1->to = free->to;
-	  copy_set(free->pos, t1->pos, b->sz.sym_size);
-	  copy_set(free->neg, t1->neg, b->sz.sym_size);
-	  t1->nxt   = free->nxt;
-	  if(free == s->trans) s->trans = t1;
-	  free_btrans(free, 0, 0);
-	  state_trans--;
+	  delete_btrans(&b->sz, s, t1);
 	}
 	else if((flags & LTL2BA_SIMP_FLY) &&
 		(t1->to == to ) &&
@@ -449,24 +615,22 @@ static void make_btrans(Buchi *b, BState *s, const int *final, Flags flags,
 	BTrans *trans = emalloc_btrans(b->sz.sym_size);
 	trans->to = to;
 	trans->to->incoming++;
+	link_btrans(s, trans);
 	copy_set(t->pos, trans->pos, b->sz.sym_size);
 	copy_set(t->neg, trans->neg, b->sz.sym_size);
 	trans->nxt = s->trans->nxt;
 	s->trans->nxt = trans;
-	state_trans++;
       }
     }
 
   if(flags & LTL2BA_SIMP_FLY) {
     if(s->trans == s->trans->nxt) { /* s has no transitions */
+      unlink_all_btrans(s);
       free_btrans(s->trans->nxt, s->trans, 1);
       s->trans = (BTrans *)0;
       s->prv = (BState *)0;
       s->nxt = bremoved->nxt;
       bremoved->nxt = s;
-      for(s1 = bremoved->nxt; s1 != bremoved; s1 = s1->nxt)
-	if(s1->prv == s)
-	  s1->prv = (BState *)0;
       return;
     }
     b->bstates->trans = s->trans;
@@ -475,14 +639,12 @@ static void make_btrans(Buchi *b, BState *s, const int *final, Flags flags,
     while(!all_btrans_match(b, s, s1))
       s1 = s1->nxt;
     if(s1 != b->bstates) { /* s and s1 are equivalent */
+      unlink_all_btrans(s);
       free_btrans(s->trans->nxt, s->trans, 1);
       s->trans = (BTrans *)0;
       s->prv = s1;
       s->nxt = bremoved->nxt;
       bremoved->nxt = s;
-      for(s1 = bremoved->nxt; s1 != bremoved; s1 = s1->nxt)
-	if(s1->prv == s)
-	  s1->prv = s->prv;
       return;
     }
   }
@@ -490,8 +652,197 @@ static void make_btrans(Buchi *b, BState *s, const int *final, Flags flags,
   s->prv = b->bstates;
   s->nxt->prv = s;
   b->bstates->nxt = s;
-  c->btrans_count += state_trans;
-  c->bstate_count++;
+}
+
+/* creates the sentinels and the (unique) initial state with its transitions */
+static void init_bstates(Buchi *b, const Generalized *g, Flags flags,
+                         BState **bstack, BState **bremoved)
+{
+  int i;
+  BState *s = (BState *)tl_emalloc(sizeof(BState));
+  GTrans *t;
+  BTrans *t1;
+
+  *bstack          = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
+  (*bstack)->nxt   = *bstack;
+  (*bstack)->prv   = *bstack;
+  *bremoved        = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
+  (*bremoved)->nxt = *bremoved;
+  b->bstates       = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
+  b->bstates->nxt  = s;
+  b->bstates->prv  = s;
+
+  s->nxt        = b->bstates; /* creates (unique) inital state */
+  s->prv        = b->bstates;
+  s->id = -1;
+  s->incoming = 1;
+  s->final = 0;
+  s->gstate = 0;
+  s->trans = emalloc_btrans(b->sz.sym_size); /* sentinel */
+  s->trans->nxt = s->trans;
+  for(i = 0; i < g->init_size; i++)
+    if(g->init[i])
+      for(t = g->init[i]->trans->nxt; t != g->init[i]->trans; t = t->nxt) {
+	int fin = next_final(b, t->final, 0, g->final);
+	GState *gto = gstate_rep(t->to); /* t->to may be removed in a lazy automaton */
+	BState *to;
+	if(!gto)
+	  continue;
+	to = find_bstate(b, &gto, fin, s, *bstack, *bremoved);
+	for(t1 = s->trans->nxt; t1 != s->trans;) {
+	  if((flags & LTL2BA_SIMP_FLY) &&
+	     (to == t1->to) &&
+	     included_set(t->pos, t1->pos, b->sz.sym_size) &&
+	     included_set(t->neg, t1->neg, b->sz.sym_size)) { /* t1 is redondant */
+	    t1->to->incoming--;
+	    delete_btrans(&b->sz, s, t1);
+	  }
+	else if((flags & LTL2BA_SIMP_FLY) &&
+		(t1->to == to ) &&
+		included_set(t1->pos, t->pos, b->sz.sym_size) &&
+		included_set(t1->neg, t->neg, b->sz.sym_size)) /* t is redondant */
+	  break;
+	  else
+	    t1 = t1->nxt;
+	}
+	if(t1 == s->trans) {
+	  BTrans *trans = emalloc_btrans(b->sz.sym_size);
+	  trans->to = to;
+	  trans->to->incoming++;
+	  link_btrans(s, trans);
+	  copy_set(t->pos, trans->pos, b->sz.sym_size);
+	  copy_set(t->neg, trans->neg, b->sz.sym_size);
+	  trans->nxt = s->trans->nxt;
+	  s->trans->nxt = trans;
+	}
+      }
+}
+
+/********************************************************************\
+|*          Transitions of the Buchi automaton by target            *|
+\********************************************************************/
+
+/* The printers merge the transitions of a state which go to the same
+ * target, i.e. to a state with the same id and final. The groups are
+ * computed once, without modifying the automaton: the groups of a state
+ * and the transitions of a group are in the order of the transitions. */
+typedef struct BGroup {
+  BState *to;
+  int first, count; /* transitions trans[first .. first+count-1] */
+} BGroup;
+
+typedef struct BIndex {
+  int nstates, ntrans;
+  BState **states; /* from b->bstates->prv on, states[i]->label == i */
+  int *group_off;  /* groups of states[i]: groups[group_off[i] .. group_off[i+1]-1] */
+  int *trans_off;  /* transitions of states[i]: trans[trans_off[i] .. trans_off[i+1]-1] */
+  BGroup *groups;
+  BTrans **trans;
+  BTrans loop;     /* TRUE self-loop of the state with id 0 */
+} BIndex;
+
+static unsigned bgroup_hash(const BState *to)
+{
+  return (unsigned)to->id * 31 + (unsigned)to->final;
+}
+
+/* returns true if s has an explicit TRUE self-loop */
+static int has_true_loop(const Buchi *b, BState *s)
+{
+  BTrans *t;
+  for(t = s->trans->nxt; t != s->trans; t = t->nxt)
+    if(t->to == s && empty_set(t->pos, b->sz.sym_size) &&
+       empty_set(t->neg, b->sz.sym_size))
+      return 1;
+  return 0;
+}
+
+/* Indexes the transitions of b. If with_loop, the state with id 0, which
+ * accepts everything, gets its TRUE self-loop as first transition when it is
+ * implicit. */
+static void make_bindex(const Buchi *b, int with_loop, BIndex *x)
+{
+  BState *s;
+  BTrans *t, **ts;
+  int i, j, g, n, deg, ntrans = 0, maxdeg = 0, hmask, *slot, *group_of, *pos;
+  unsigned h;
+
+  memset(x, 0, sizeof(*x));
+  for(s = b->bstates->prv; s != b->bstates; s = s->prv) {
+    deg = (with_loop && s->id == 0 && !has_true_loop(b, s));
+    for(t = s->trans->nxt; t != s->trans; t = t->nxt)
+      deg++;
+    ntrans += deg;
+    if(deg > maxdeg)
+      maxdeg = deg;
+    x->nstates++;
+  }
+  x->states = (BState **)tl_emalloc((x->nstates + 1) * sizeof(BState *));
+  x->group_off = (int *)tl_emalloc((x->nstates + 1) * sizeof(int));
+  x->trans_off = (int *)tl_emalloc((x->nstates + 1) * sizeof(int));
+  x->groups = (BGroup *)tl_emalloc((ntrans + 1) * sizeof(BGroup));
+  x->trans = (BTrans **)tl_emalloc((ntrans + 1) * sizeof(BTrans *));
+  for(hmask = 1; hmask < 2 * maxdeg; hmask <<= 1)
+    ;
+  slot = (int *)tl_emalloc(hmask * sizeof(int));
+  memset(slot, -1, hmask * sizeof(int));
+  hmask--;
+  ts = (BTrans **)tl_emalloc((maxdeg + 1) * sizeof(BTrans *));
+  group_of = (int *)tl_emalloc((maxdeg + 1) * sizeof(int));
+  pos = (int *)tl_emalloc((ntrans + 1) * sizeof(int));
+
+  ntrans = g = 0;
+  for(i = 0, s = b->bstates->prv; s != b->bstates; i++, s = s->prv) {
+    x->states[i] = s;
+    s->label = i;
+    x->group_off[i] = g;
+    x->trans_off[i] = ntrans;
+    n = 0;
+    if(with_loop && s->id == 0 && !has_true_loop(b, s)) {
+      x->loop.to = s;
+      ts[n++] = &x->loop;
+    }
+    for(t = s->trans->nxt; t != s->trans; t = t->nxt)
+      ts[n++] = t;
+    for(j = 0; j < n; j++) {
+      /* the slots holding a group of a previous state are free */
+      for(h = bgroup_hash(ts[j]->to) & hmask; slot[h] >= x->group_off[i];
+          h = (h + 1) & hmask)
+        if(x->groups[slot[h]].to->id == ts[j]->to->id &&
+           x->groups[slot[h]].to->final == ts[j]->to->final)
+          break;
+      if(slot[h] < x->group_off[i]) { /* new group */
+        slot[h] = g;
+        x->groups[g].to = ts[j]->to;
+        x->groups[g++].count = 0;
+      }
+      group_of[j] = slot[h];
+      x->groups[slot[h]].count++;
+    }
+    for(j = x->group_off[i]; j < g; j++) {
+      x->groups[j].first = ntrans;
+      pos[j] = ntrans;
+      ntrans += x->groups[j].count;
+    }
+    for(j = 0; j < n; j++)
+      x->trans[pos[group_of[j]]++] = ts[j];
+  }
+  x->group_off[i] = g;
+  x->trans_off[i] = x->ntrans = ntrans;
+
+  tfree(slot);
+  tfree(ts);
+  tfree(group_of);
+  tfree(pos);
+}
+
+static void free_bindex(BIndex *x)
+{
+  tfree(x->states);
+  tfree(x->group_off);
+  tfree(x->trans_off);
+  tfree(x->groups);
+  tfree(x->trans);
 }
 
 /********************************************************************\
@@ -499,186 +850,254 @@ static void make_btrans(Buchi *b, BState *s, const int *final, Flags flags,
 \********************************************************************/
 
 /* dumps the Buchi automaton */
-static void print_buchi(FILE *f, const char *const *sym_table,
+static void print_buchi(Writer *f, const Symbol *const *sym_table,
                         const Cexprtab *cexpr, const Buchi *b, BState *s,
                         int scc_size)
 {
+  BState *local[64], **st = local;
+  int sp = 0, size = 64;
   BTrans *t;
-  if(s == b->bstates) return;
-
-  print_buchi(f, sym_table, cexpr, b, s->nxt, scc_size); /* begins with the last state */
 
-  fprintf(f, "state ");
-  if(s->id == -1)
-    fprintf(f, "init");
-  else {
-    if(s->final == b->accept)
-      fprintf(f, "accept");
-    else
-      fprintf(f, "T%i", s->final);
-    fprintf(f, "_%i", s->id);
-  }
-  fprintf(f, "\n");
-  for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
-    if (empty_set(t->pos, b->sz.sym_size) && empty_set(t->neg, b->sz.sym_size))
-      fprintf(f, "1");
-    print_sym_set(f, sym_table, cexpr, t->pos, b->sz.sym_size);
-    if (!empty_set(t->pos, b->sz.sym_size) && !empty_set(t->neg, b->sz.sym_size)) fprintf(f, " & ");
-    print_sym_set(f, sym_table, cexpr, t->neg, b->sz.sym_size);
-    fprintf(f, " -> ");
-    if(t->to->id == -1)
-      fprintf(f, "init\n");
+  for(; s != b->bstates; s = s->nxt)
+    STACK_PUSH(st, sp, size, local, s);
+  while(sp) { /* begins with the last state */
+    s = st[--sp];
+    w_printf(f, "state ");
+    if(s->id == -1)
+      w_printf(f, "init");
     else {
-      if(t->to->final == b->accept)
-	fprintf(f, "accept");
+      if(s->final == b->accept)
+        w_printf(f, "accept");
       else
-	fprintf(f, "T%i", t->to->final);
-      fprintf(f, "_%i\n", t->to->id);
+        w_printf(f, "T%i", s->final);
+      w_printf(f, "_%i", s->id);
+    }
+    w_printf(f, "\n");
+    for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
+      if (empty_set(t->pos, b->sz.sym_size) && empty_set(t->neg, b->sz.sym_size))
+        w_printf(f, "1");
+      print_sym_set(f, sym_table, cexpr, t->pos, b->sz.sym_size);
+      if (!empty_set(t->pos, b->sz.sym_size) && !empty_set(t->neg, b->sz.sym_size)) w_printf(f, " & ");
+      print_sym_set(f, sym_table, cexpr, t->neg, b->sz.sym_size);
+      w_printf(f, " -> ");
+      if(t->to->id == -1)
+        w_printf(f, "init\n");
+      else {
+        if(t->to->final == b->accept)
+	  w_printf(f, "accept");
+        else
+	  w_printf(f, "T%i", t->to->final);
+        w_printf(f, "_%i\n", t->to->id);
+      }
     }
   }
+  STACK_FREE(st, local);
 }
 
-void print_spin_buchi(FILE *f, const Buchi *b, const char **sym_table) {
+void print_spin_buchi(Writer *f, const Buchi *b, const Symbol *const *sym_table) {
   BTrans *t;
   BState *s;
-  int accept_all = 0;
+  BIndex x;
+  BGroup *g;
+  int i, j, accept_all = 0;
   if(b->bstates->nxt == b->bstates) { /* empty automaton */
-    fprintf(f, "never {    /* ");
+    w_printf(f, "never {    /* ");
     put_uform(f);
-    fprintf(f, " */\n");
-    fprintf(f, "T0_init:\n");
-    fprintf(f, "\tfalse;\n");
-    fprintf(f, "}\n");
+    w_printf(f, " */\n");
+    w_printf(f, "T0_init:\n");
+    w_printf(f, "\tfalse;\n");
+    w_printf(f, "}\n");
     return;
   }
   if(b->bstates->nxt->nxt == b->bstates && b->bstates->nxt->id == 0) { /* true */
-    fprintf(f, "never {    /* ");
+    w_printf(f, "never {    /* ");
     put_uform(f);
-    fprintf(f, " */\n");
-    fprintf(f, "accept_init:\n");
-    fprintf(f, "\tif\n");
-    fprintf(f, "\t:: (1) -> goto accept_init\n");
-    fprintf(f, "\tfi;\n");
-    fprintf(f, "}\n");
+    w_printf(f, " */\n");
+    w_printf(f, "accept_init:\n");
+    w_printf(f, "\tif\n");
+    w_printf(f, "\t:: (1) -> goto accept_init\n");
+    w_printf(f, "\tfi;\n");
+    w_printf(f, "}\n");
     return;
   }
 
-  fprintf(f, "never { /* ");
+  w_printf(f, "never { /* ");
   put_uform(f);
-  fprintf(f, " */\n");
-  for(s = b->bstates->prv; s != b->bstates; s = s->prv) {
+  w_printf(f, " */\n");
+  make_bindex(b, 0, &x);
+  for(i = 0; i < x.nstates; i++) {
+    s = x.states[i];
     if(s->id == 0) { /* accept_all at the end */
       accept_all = 1;
       continue;
     }
     if(s->final == b->accept)
-      fprintf(f, "accept_");
-    else fprintf(f, "T%i_", s->final);
+      w_printf(f, "accept_");
+    else w_printf(f, "T%i_", s->final);
     if(s->id == -1)
-      fprintf(f, "init:\n");
-    else fprintf(f, "S%i:\n", s->id);
+      w_printf(f, "init:\n");
+    else w_printf(f, "S%i:\n", s->id);
     if(s->trans->nxt == s->trans) {
-      fprintf(f, "\tfalse;\n");
+      w_printf(f, "\tfalse;\n");
       continue;
     }
-    fprintf(f, "\tif\n");
-    for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
-      BTrans *t1;
-      fprintf(f, "\t:: (");
-      spin_print_set(f, sym_table, t->pos, t->neg, b->sz.sym_size);
-      for(t1 = t; t1->nxt != s->trans; )
-	if (t1->nxt->to->id == t->to->id &&
-	    t1->nxt->to->final == t->to->final) {
-	  fprintf(f, ") || (");
-	  spin_print_set(f, sym_table, t1->nxt->pos, t1->nxt->neg, b->sz.sym_size);
-	  t1->nxt = t1->nxt->nxt;
-	}
-	else  t1 = t1->nxt;
-      fprintf(f, ") -> goto ");
-      if(t->to->final == b->accept)
-	fprintf(f, "accept_");
-      else fprintf(f, "T%i_", t->to->final);
-      if(t->to->id == 0)
-	fprintf(f, "all\n");
-      else if(t->to->id == -1)
-	fprintf(f, "init\n");
-      else fprintf(f, "S%i\n", t->to->id);
+    w_printf(f, "\tif\n");
+    for(g = &x.groups[x.group_off[i]]; g < &x.groups[x.group_off[i + 1]]; g++) {
+      w_printf(f, "\t:: (");
+      for(j = g->first; j < g->first + g->count; j++) {
+	t = x.trans[j];
+	if(j > g->first)
+	  w_printf(f, ") || (");
+	spin_print_set(f, sym_table, t->pos, t->neg, b->sz.sym_size);
+      }
+      w_printf(f, ") -> goto ");
+      if(g->to->final == b->accept)
+	w_printf(f, "accept_");
+      else w_printf(f, "T%i_", g->to->final);
+      if(g->to->id == 0)
+	w_printf(f, "all\n");
+      else if(g->to->id == -1)
+	w_printf(f, "init\n");
+      else w_printf(f, "S%i\n", g->to->id);
     }
-    fprintf(f, "\tfi;\n");
+    w_printf(f, "\tfi;\n");
   }
+  free_bindex(&x);
   if(accept_all) {
-    fprintf(f, "accept_all:\n");
-    fprintf(f, "\tskip\n");
+    w_printf(f, "accept_all:\n");
+    w_printf(f, "\tskip\n");
   }
-  fprintf(f, "}\n");
+  w_printf(f, "}\n");
 }
 
-static void print_dot_state_name(FILE *f, const Buchi *b, BState *s) {
-  if (s->id == -1) fprintf(f, "init");
-  else if (s->id == 0) fprintf(f,"all");
+static void print_dot_state_name(Writer *f, const Buchi *b, BState *s) {
+  if (s->id == -1) w_printf(f, "init");
+  else if (s->id == 0) w_printf(f,"all");
   else {
-    if (s->final != b->accept) fprintf(f,"T%i_",s->final);
-	fprintf(f,"%i",s->id);
+    if (s->final != b->accept) w_printf(f,"T%i_",s->final);
+	w_printf(f,"%i",s->id);
   }
 }
 
-void print_dot_buchi(FILE *f, const Buchi *b, const char *const *sym_table, const Cexprtab *cexpr) {
+void print_dot_buchi(Writer *f, const Buchi *b, const Symbol *const *sym_table, const Cexprtab *cexpr) {
   BTrans *t;
   BState *s;
-  int accept_all = 0, init_count = 0;
+  BIndex x;
+  BGroup *g;
+  int i, j, accept_all = 0, init_count = 0;
   if(b->bstates->nxt == b->bstates) { /* empty automaton */
-    fprintf(f, "digraph G {\n");
-    fprintf(f, "init [shape=circle]\n");
-    fprintf(f, "}\n");
+    w_printf(f, "digraph G {\n");
+    w_printf(f, "init [shape=circle]\n");
+    w_printf(f, "}\n");
     return;
   }
   if(b->bstates->nxt->nxt == b->bstates && b->bstates->nxt->id == 0) { /* true */
-    fprintf(f, "digraph G {\n");
-    fprintf(f, "init -> init [label=\"{true}\",font=\"courier\"]\n");
-    fprintf(f, "init [shape=doublecircle]\n");
-    fprintf(f, "}\n");
+    w_printf(f, "digraph G {\n");
+    w_printf(f, "init -> init [label=\"{true}\",font=\"courier\"]\n");
+    w_printf(f, "init [shape=doublecircle]\n");
+    w_printf(f, "}\n");
     return;
   }
 
-  fprintf(f, "digraph G {\n");
-  for(s = b->bstates->prv; s != b->bstates; s = s->prv) {
+  w_printf(f, "digraph G {\n");
+  make_bindex(b, 0, &x);
+  for(i = 0; i < x.nstates; i++) {
+    s = x.states[i];
     if(s->id == 0) { /* accept_all at the end */
-      fprintf(f, "all [shape=doublecircle]\n");
-	  fprintf(f,"all -> all [label=\"true\", fontname=\"Courier\", fontcolor=blue]");
+      w_printf(f, "all [shape=doublecircle]\n");
+	  w_printf(f,"all -> all [label=\"true\", fontname=\"Courier\", fontcolor=blue]");
       continue;
     }
 	print_dot_state_name(f, b, s);
     if(s->final == b->accept)
-      fprintf(f, " [shape=doublecircle]\n");
-    else fprintf(f, " [shape=circle]\n");
+      w_printf(f, " [shape=doublecircle]\n");
+    else w_printf(f, " [shape=circle]\n");
     if(s->trans->nxt == s->trans) {
       continue;
     }
-    for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
-	  int need_parens=0;
-      BTrans *t1;
+    for(g = &x.groups[x.group_off[i]]; g < &x.groups[x.group_off[i + 1]]; g++) {
       print_dot_state_name(f, b, s);
-      fprintf(f, " -> ");
-	  if (t->nxt->to->id == t->to->id &&
-	        t->nxt->to->final == t->to->final)
-		need_parens=1;
-      print_dot_state_name(f, b, t->to);
-	  fprintf(f, " [label=\""),
-      dot_print_set(f, sym_table, cexpr, t->pos, t->neg, b->sz.sym_size, need_parens);
-      for(t1 = t; t1->nxt != s->trans; )
-	    if (t1->nxt->to->id == t->to->id &&
-	        t1->nxt->to->final == t->to->final) {
-	      fprintf(f, "||");
-	      dot_print_set(f, sym_table, cexpr, t1->nxt->pos, t1->nxt->neg, b->sz.sym_size, b->sz.sym_size); /* TODO: need_parens == (sym_size != 0)? */
-	      t1->nxt = t1->nxt->nxt;
-	    }
-	    else
-		  t1 = t1->nxt;
-        fprintf(f, "\", fontname=\"Courier\", fontcolor=blue]\n");
+      w_printf(f, " -> ");
+      print_dot_state_name(f, b, g->to);
+	  w_printf(f, " [label=\"");
+      for(j = g->first; j < g->first + g->count; j++) {
+	t = x.trans[j];
+	if(j > g->first)
+	  w_printf(f, "||");
+	/* the conjunctions of a disjunction are parenthesized */
+	dot_print_set(f, sym_table, cexpr, t->pos, t->neg, b->sz.sym_size, g->count > 1);
+      }
+        w_printf(f, "\", fontname=\"Courier\", fontcolor=blue]\n");
 
     }
   }
-  fprintf(f, "}\n");
+  free_bindex(&x);
+  w_printf(f, "}\n");
+}
+
+/********************************************************************\
+|*            Lazy generation of the Buchi automaton                *|
+\********************************************************************/
+
+/* Starts a Buchi automaton whose states are only solved when their
+ * successors are asked for, e.g. by an explicit-state product exploration.
+ * The states and transitions returned remain valid; a state that has been
+ * merged with another one on the fly gets the successors of that one. */
+Lazy mk_lazy_buchi(const Alternating *alt, Flags flags)
+{
+  Lazy lz = { .alt = alt, .flags = flags & (LTL2BA_SIMP_FLY | LTL2BA_FJTOFJ), };
+
+  lazy_generalized(&lz);
+  lz.b.accept = lz.g.final[0] - 1;
+  lz.b.sz = lz.g.sz;
+  lz.none = emalloc_btrans(lz.b.sz.sym_size); /* sentinel */
+  lz.none->nxt = lz.none;
+  return lz;
+}
+
+/* returns the initial state of the Buchi automaton */
+BState *lazy_init_bstate(Lazy *lz)
+{
+  int i;
+  if(!lz->init) {
+    for(i = 0; i < lz->g.init_size; i++)
+      if(lz->g.init[i])
+        lz->g.init[i] = expand_gstate(lz, lz->g.init[i]);
+    init_bstates(&lz->b, &lz->g, lz->flags, &lz->bstack, &lz->bremoved);
+    lz->init = lz->b.bstates->nxt;
+  }
+  return lz->init;
+}
+
+/* solves s if it is still in the stack and returns the sentinel of the
+ * transitions from s */
+BTrans *lazy_bsuccessors(Lazy *lz, BState *s)
+{
+  BTrans *t;
+
+  if(s->dirty & DIRTY_PENDING) {
+    pop_bstate(s);
+    expand_gstate(lz, s->gstate);
+    make_btrans(&lz->b, s, lz->g.final, lz->flags, lz->bstack, lz->bremoved,
+                (Status *)0);
+  }
+  if(!(s = bstate_rep(s)))
+    return lz->none;
+  for(t = s->trans->nxt; t != s->trans; ) /* retargets to removed states */
+    if(!t->to->trans) {
+      BState *rep = bstate_rep(t->to);
+      if(!rep)
+        delete_btrans(&lz->b.sz, s, t);
+      else {
+        unlink_btrans(t);
+        t->to = rep;
+        link_btrans(s, t);
+        t = t->nxt;
+      }
+    }
+    else
+      t = t->nxt;
+  return s->trans;
 }
 
 /********************************************************************\
@@ -686,160 +1105,127 @@ void print_dot_buchi(FILE *f, const Buchi *b, const char *const *sym_table, cons
 \********************************************************************/
 
 /* generates a Buchi automaton from the generalized Buchi automaton */
-Buchi mk_buchi(Generalized *g, FILE *f, Flags flags, const char *const *sym_table, const Cexprtab *cexpr)
+Buchi mk_buchi(Generalized *g, FILE *f, Flags flags, const Symbol *const *sym_table, const Cexprtab *cexpr,
+               Stats *stats)
 {
-  int i;
-  BState *s = (BState *)tl_emalloc(sizeof(BState));
-  GTrans *t;
-  BTrans *t1;
+  BState *s;
   Buchi b = { .accept = g->final[0] - 1, .sz = g->sz, };
-  struct rusage tr_debut, tr_fin;
-  struct timeval t_diff;
-  struct bcounts cnts;
-  memset(&cnts, 0, sizeof(cnts));
+  StatsClock stage;
+  Stage *st = stats ? &stats->buchi : NULL;
 
   BState *bstack, *bremoved;
 
-  if(flags & LTL2BA_STATS) getrusage(RUSAGE_SELF, &tr_debut);
+  if((b.status = g->status))
+    return b;
 
-  bstack         = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
-  bstack->nxt    = bstack;
-  bremoved       = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
-  bremoved->nxt  = bremoved;
-  b.bstates      = (BState *)tl_emalloc(sizeof(BState)); /* sentinel */
-  b.bstates->nxt = s;
-  b.bstates->prv = s;
+  if(st) {
+    stats_stage(st);
+    stats_start(&stage);
+  }
 
-  s->nxt        = b.bstates; /* creates (unique) inital state */
-  s->prv        = b.bstates;
-  s->id = -1;
-  s->incoming = 1;
-  s->final = 0;
-  s->gstate = 0;
-  s->trans = emalloc_btrans(b.sz.sym_size); /* sentinel */
-  s->trans->nxt = s->trans;
-  for(i = 0; i < g->init_size; i++)
-    if(g->init[i])
-      for(t = g->init[i]->trans->nxt; t != g->init[i]->trans; t = t->nxt) {
-	int fin = next_final(&b, t->final, 0, g->final);
-	BState *to = find_bstate(&b, &t->to, fin, s, bstack, bremoved);
-	for(t1 = s->trans->nxt; t1 != s->trans;) {
-	  if((flags & LTL2BA_SIMP_FLY) &&
-	     (to == t1->to) &&
-	     included_set(t->pos, t1->pos, b.sz.sym_size) &&
-	     included_set(t->neg, t1->neg, b.sz.sym_size)) { /* t1 is redondant */
-	    BTrans *free = t1->nxt;
-	    t1->to->incoming--;
-	    t1->to = free->to;
-	    copy_set(free->pos, t1->pos, b.sz.sym_size);
-	    copy_set(free->neg, t1->neg, b.sz.sym_size);
-	    t1->nxt   = free->nxt;
-	    if(free == s->trans) s->trans = t1;
-	    free_btrans(free, 0, 0);
-	  }
-	else if((flags & LTL2BA_SIMP_FLY) &&
-		(t1->to == to ) &&
-		included_set(t1->pos, t->pos, b.sz.sym_size) &&
-		included_set(t1->neg, t->neg, b.sz.sym_size)) /* t is redondant */
-	  break;
-	  else
-	    t1 = t1->nxt;
-	}
-	if(t1 == s->trans) {
-	  BTrans *trans = emalloc_btrans(b.sz.sym_size);
-	  trans->to = to;
-	  trans->to->incoming++;
-	  copy_set(t->pos, trans->pos, b.sz.sym_size);
-	  copy_set(t->neg, trans->neg, b.sz.sym_size);
-	  trans->nxt = s->trans->nxt;
-	  s->trans->nxt = trans;
-	}
-      }
+  init_bstates(&b, g, flags, &bstack, &bremoved);
 
   while(bstack->nxt != bstack) { /* solves all states in the stack until it is empty */
     s = bstack->nxt;
-    bstack->nxt = bstack->nxt->nxt;
+    pop_bstate(s);
     if(!s->incoming) {
       free_bstate(s);
       continue;
     }
-    make_btrans(&b, s, g->final, flags, &cnts, bstack, bremoved);
+    make_btrans(&b, s, g->final, flags, bstack, bremoved, &b.status);
+    if(b.status)
+      return b;
   }
 
   retarget_all_btrans(&b, bremoved);
 
-  if(flags & LTL2BA_STATS) {
-    getrusage(RUSAGE_SELF, &tr_fin);
-    timeval_subtract (&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
-    fprintf(f, "\nBuilding the Buchi automaton : %ld.%06lis",
-		t_diff.tv_sec, t_diff.tv_usec);
-    fprintf(f, "\n%i states, %i transitions\n", cnts.bstate_count, cnts.btrans_count);
+  if(st) {
+    stats_stop(&stage, &st->build);
+    count_bstates(&b, &st->states, &st->trans);
   }
 
   if(flags & LTL2BA_VERBOSE) {
+    Writer w;
     fprintf(f, "\nBuchi automaton before simplification\n");
-    print_buchi(f, sym_table, cexpr, &b, b.bstates->nxt, g->scc_size);
+    ltl2ba_writer_file(&w, f);
+    print_buchi(&w, sym_table, cexpr, &b, b.bstates->nxt, g->scc_size);
+    ltl2ba_writer_free(&w);
     if(b.bstates == b.bstates->nxt)
       fprintf(f, "empty automaton, refuses all words\n");
   }
 
   if(flags & LTL2BA_SIMP_DIFF) {
-    simplify_btrans(&b, f, flags);
-    if(flags & LTL2BA_SIMP_SCC) simplify_bscc(&b, bremoved);
-    while(simplify_bstates(&b, f, flags, &g->gstate_id, bremoved)) { /* simplifies as much as possible */
-      simplify_btrans(&b, f, flags);
-      if(flags & LTL2BA_SIMP_SCC) simplify_bscc(&b, bremoved);
+    for(s = b.bstates->nxt; s != b.bstates; s = s->nxt)
+      s->dirty = DIRTY_TRANS | DIRTY_STATES | DIRTY_FINAL; /* everything is examined first */
+    simplify_btrans(&b, st);
+    if(flags & LTL2BA_SIMP_SCC) simplify_bscc(&b, bremoved, st);
+    while(!(b.status = check_stop()) &&
+          simplify_bstates(&b, &g->gstate_id, bremoved, st)) { /* simplifies as much as possible */
+      simplify_btrans(&b, st);
+      if(flags & LTL2BA_SIMP_SCC) simplify_bscc(&b, bremoved, st);
     }
+    if(b.status)
+      return b;
 
     if(flags & LTL2BA_VERBOSE) {
+      Writer w;
       fprintf(f, "\nBuchi automaton after simplification\n");
-      print_buchi(f, sym_table, cexpr, &b, b.bstates->nxt, g->scc_size);
+      ltl2ba_writer_file(&w, f);
+      print_buchi(&w, sym_table, cexpr, &b, b.bstates->nxt, g->scc_size);
+      ltl2ba_writer_free(&w);
       if(b.bstates == b.bstates->nxt)
 	fprintf(f, "empty automaton, refuses all words\n");
       fprintf(f, "\n");
     }
   }
 
+  if(st) {
+    stats_stop(&stage, &st->time);
+    stats_memory(stats);
+  }
+
   return b;
 }
 
 
-static void print_c_headers(FILE *f, const Cexprtab *cexpr,
+static void print_c_headers(Writer *f, const Cexprtab *cexpr,
                             const char *c_sym_name_prefix,
                             const char *extern_header)
 {
   int i;
 
   /* Need some headers... */
-  fprintf(f, "#include <pthread.h>\n");
-  fprintf(f, "#include <stdbool.h>\n");
-  fprintf(f, "#include <stdint.h>\n\n");
+  w_printf(f, "#include <pthread.h>\n");
+  w_printf(f, "#include <stdbool.h>\n");
+  w_printf(f, "#include <stdint.h>\n\n");
 
   /* Declare ESBMC routines we'll be using too */
-  fprintf(f, "void __ESBMC_switch_to_monitor(void);\n");
-  fprintf(f, "void __ESBMC_switch_from_monitor(void);\n");
-  fprintf(f, "void __ESBMC_register_monitor(pthread_t t);\n");
-  fprintf(f, "void __ESBMC_really_atomic_begin();\n");
-  fprintf(f, "void __ESBMC_really_atomic_end();\n");
-  fprintf(f, "void __ESBMC_atomic_begin();\n");
-  fprintf(f, "void __ESBMC_atomic_end();\n");
-  fprintf(f, "void __ESBMC_assume(_Bool prop);\n");
-  fprintf(f, "void __ESBMC_kill_monitor();\n");
-  fprintf(f, "unsigned int nondet_uint();\n\n");
+  w_printf(f, "void __ESBMC_switch_to_monitor(void);\n");
+  w_printf(f, "void __ESBMC_switch_from_monitor(void);\n");
+  w_printf(f, "void __ESBMC_register_monitor(pthread_t t);\n");
+  w_printf(f, "void __ESBMC_really_atomic_begin();\n");
+  w_printf(f, "void __ESBMC_really_atomic_end();\n");
+  w_printf(f, "void __ESBMC_atomic_begin();\n");
+  w_printf(f, "void __ESBMC_atomic_end();\n");
+  w_printf(f, "void __ESBMC_assume(_Bool prop);\n");
+  w_printf(f, "void __ESBMC_kill_monitor();\n");
+  w_printf(f, "unsigned int nondet_uint();\n\n");
+
+  w_printf(f, "unsigned int %s_sym_to_idx(void);\n\n", c_sym_name_prefix);
 
   if (extern_header)
-    fprintf(f, "#include %s\n", extern_header);
+    w_printf(f, "#include %s\n", extern_header);
 
   /* Pump out the C expressions we'll be using */
   for (i = 0; i < cexpr->cexpr_idx; i++) {
-    fprintf(f, "char __ESBMC_property__ltl2ba_cexpr_%d[] = \"%s\";\n",
+    w_printf(f, "char __ESBMC_property__ltl2ba_cexpr_%d[] = \"%s\";\n",
             i, cexpr->cexpr_expr_table[i]);
-    fprintf(f, "int %s_cexpr_%d_status(void) { return %s; }\n",
+    w_printf(f, "int %s_cexpr_%d_status(void) { return %s; }\n",
             c_sym_name_prefix, i, cexpr->cexpr_expr_table[i]);
   }
 }
 
-static int print_enum_decl(FILE *f, const Buchi *b,
+static int print_enum_decl(Writer *f, const Buchi *b,
                            const char *c_sym_name_prefix)
 {
   BState *s;
@@ -847,141 +1233,253 @@ static int print_enum_decl(FILE *f, const Buchi *b,
 
   /* Generate enumeration of states */
 
-  fprintf(f, "\ntypedef enum {\n");
+  w_printf(f, "\ntypedef enum {\n");
   for (s = b->bstates->prv; s != b->bstates; s = s->prv) {
     num_states++;
-    fprintf(f, "\t%s_state_%d,\n", c_sym_name_prefix, s->label);
+    w_printf(f, "\t%s_state_%d,\n", c_sym_name_prefix, s->label);
   }
 
-  fprintf(f, "} %s_state;\n\n", c_sym_name_prefix);
+  w_printf(f, "} %s_state;\n\n", c_sym_name_prefix);
 
   return num_states;
 }
 
-static void print_buchi_statevars(FILE *f, const Buchi *b, const char *prefix,
+static void print_buchi_statevars(Writer *f, const Buchi *b, const char *prefix,
                                   int num_states)
 {
   BState *s;
 
-  fprintf(f, "%s_state %s_statevar =", prefix, prefix);
+  w_printf(f, "%s_state %s_statevar =", prefix, prefix);
 
   s = b->bstates->prv;
-  fprintf(f, "%s_state_0;\n\n", prefix);
+  w_printf(f, "%s_state_0;\n\n", prefix);
 
-  fprintf(f, "unsigned int %s_visited_states[%d];\n\n", prefix, num_states);
+  w_printf(f, "unsigned int %s_visited_states[%d];\n\n", prefix, num_states);
 }
 
-static void print_fsm_func_opener(FILE *f)
+static void print_fsm_func_opener(Writer *f)
 {
-  fprintf(f, "void\nltl2ba_fsm(bool state_stats, unsigned int num_iters)\n{\n");
-  fprintf(f, "\tunsigned int choice;\n");
-  fprintf(f, "\tunsigned int iters;\n");
-  fprintf(f, "\t_Bool state_is_viable;\n\n");
+  w_printf(f, "void\nltl2ba_fsm(bool state_stats, unsigned int num_iters)\n{\n");
+  w_printf(f, "\tunsigned int choice;\n");
+  w_printf(f, "\tunsigned int iters;\n");
+  w_printf(f, "\tunsigned int idx;\n\n");
 
-  fprintf(f, "\t/* Original formula:\n\t * ");
+  w_printf(f, "\t/* Original formula:\n\t * ");
   put_uform(f);
-  fprintf(f, "\n\t */\n\n");
+  w_printf(f, "\n\t */\n\n");
 
-  fprintf(f, "\tfor (iters = 0; iters < num_iters; iters++) {\n");
+  w_printf(f, "\tfor (iters = 0; iters < num_iters; iters++) {\n");
 
   return;
 }
 
-static void print_transition_guard(FILE *f, const Buchi *b, BTrans *t,
-                                   BState *state, const char *const *sym_table)
+/* mask of the symbols of l among the bits of _sym_to_idx() */
+static unsigned c_sym_mask(int *l, int sym_id)
 {
-  BTrans *t1;
-  c_print_set(f, sym_table, t->pos, t->neg, b->sz.sym_size);
-  for(t1 = t->nxt; t1 != state->trans; t1=t1->nxt) {
-    if (t1->to->id == t->to->id && t1->to->final == t->to->final){
-      fprintf(f, ") || (");
-      c_print_set(f, sym_table, t1->pos, t1->neg, b->sz.sym_size);
-    }
+  unsigned m = 0;
+  int i;
+  for (i = 0; i < sym_id; i++)
+    if (in_set(l, i))
+      m |= 1U << i;
+  return m;
+}
+
+static void print_transition_guard(Writer *f, const Buchi *b, const BIndex *x,
+                                   const BGroup *g, const Symbol *const *sym_table)
+{
+  int j;
+  for(j = g->first; j < g->first + g->count; j++) {
+    if (j > g->first)
+      w_printf(f, ") || (");
+    c_print_set(f, sym_table, x->trans[j]->pos, x->trans[j]->neg, b->sz.sym_size);
   }
 }
 
-static void print_state_name(FILE *f, BState *s, const char *prefix)
+/* the guard of g as a test on the letter idx read once for the step */
+static void print_transition_mask(Writer *f, const BIndex *x, const BGroup *g,
+                                   int sym_id)
 {
-  fprintf(f, "%s_state_%d", prefix, s->label);
+  BTrans *t;
+  int j;
+  for(j = g->first; j < g->first + g->count; j++) {
+    t = x->trans[j];
+    if (j > g->first)
+      w_printf(f, " || ");
+    if (!t->pos && !t->neg)
+      w_printf(f, "1");
+    else
+      w_printf(f, "(idx & %#x) == %#x",
+               (t->pos ? c_sym_mask(t->pos, sym_id) : 0) |
+               (t->neg ? c_sym_mask(t->neg, sym_id) : 0),
+               t->pos ? c_sym_mask(t->pos, sym_id) : 0);
+  }
+}
+
+static void print_state_name(Writer *f, BState *s, const char *prefix)
+{
+  w_printf(f, "%s_state_%d", prefix, s->label);
   return;
 }
 
-static int print_c_buchi_body(FILE *f, const Buchi *b,
-                              const char *const *sym_table, const char *prefix)
+static int print_c_buchi_body(Writer *f, const Buchi *b, const BIndex *x,
+                              const Symbol *const *sym_table, int sym_id,
+                              const char *prefix)
 {
-  BTrans *t, *t1;
   BState *s;
-  int choice_count;
-  int g_num_states = 0;
-
-  /* Calculate number of states, globally */
-  for (s = b->bstates->prv; s != b->bstates; s = s->prv)
-    g_num_states++;
-
-  /* Start in first state? From loops, ltl2ba reverses order...*/
-  s = b->bstates->prv;
+  const BGroup *g;
+  int i, choice_count;
 
-  fprintf(f, "\t\tchoice = nondet_uint();\n\n");
-  fprintf(f, "\t\t__ESBMC_atomic_begin();\n\n");
-  fprintf(f, "\t\tswitch(%s_statevar) {\n", prefix);
+  w_printf(f, "\t\tchoice = nondet_uint();\n\n");
+  w_printf(f, "\t\t__ESBMC_atomic_begin();\n\n");
+  /* each predicate is evaluated once per step */
+  w_printf(f, "\t\tidx = %s_sym_to_idx();\n\n", prefix);
+  w_printf(f, "\t\tswitch(%s_statevar) {\n", prefix);
 
-  for (s = b->bstates->prv; s != b->bstates; s = s->prv) {
+  for (i = 0; i < x->nstates; i++) {
+    s = x->states[i];
     choice_count = 0;
 
     /* In each state... */
-    fprintf(f, "\t\tcase ");
+    w_printf(f, "\t\tcase ");
     print_state_name(f, s, prefix);
-    fprintf(f, ":\n");
-
-    fprintf(f, "\t\t\tstate_is_viable = (((");
-    for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
-      print_transition_guard(f, b, t, s, sym_table);
-      fprintf(f, ")) || ((");
-    }
-    fprintf(f, "false)));\n");
+    w_printf(f, ":\n");
 
-    fprintf(f, "\t\t\t");
-    for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
-#if 0
-      if (empty_set(t->pos, sym_size) && empty_set(t->neg, sym_size)) {
-        continue;
-      }
-#endif
 
-      fprintf(f, "if (choice == %d) {\n", choice_count++);
+    /* one choice per target */
+    w_printf(f, "\t\t\t");
+    for(g = &x->groups[x->group_off[i]]; g < &x->groups[x->group_off[i + 1]]; g++) {
+      w_printf(f, "if (choice == %d) {\n", choice_count++);
 
-      fprintf(f, "\t\t\t\t__ESBMC_assume(((");
-      print_transition_guard(f, b, t, s, sym_table);
-      fprintf(f, ")));\n");
+      w_printf(f, "\t\t\t\t/* (");
+      print_transition_guard(f, b, x, g, sym_table);
+      w_printf(f, ") */\n");
+      w_printf(f, "\t\t\t\t__ESBMC_assume(");
+      print_transition_mask(f, x, g, sym_id);
+      w_printf(f, ");\n");
 
-      fprintf(f, "\t\t\t\t%s_statevar = ", prefix);
+      w_printf(f, "\t\t\t\t%s_statevar = ", prefix);
 
-      print_state_name(f, t->to, prefix);
-      fprintf(f, ";\n", prefix);
+      print_state_name(f, g->to, prefix);
+      w_printf(f, ";\n");
 
-      fprintf(f, "\t\t\t} else ");
+      w_printf(f, "\t\t\t} else ");
     }
 
     /* And finally, a clause for if none of those transitions are viable */
-    fprintf(f, "{\n");
-    fprintf(f, "\t\t\t\t__ESBMC_assume(0);\n");
-    fprintf(f, "\t\t\t}\n");
+    w_printf(f, "{\n");
+    w_printf(f, "\t\t\t\t__ESBMC_assume(0);\n");
+    w_printf(f, "\t\t\t}\n");
 
-    fprintf(f, "\t\t\tbreak;\n");
+    w_printf(f, "\t\t\tbreak;\n");
   }
 
-  fprintf(f, "\t\t}\n");
-  fprintf(f, "\t\tif (state_stats)\n");
-  fprintf(f, "\t\t\t%s_visited_states[%s_statevar]++;\n\n", prefix, prefix);
-  fprintf(f, "\t\t/* __ESBMC_really_atomic_end(); */\n");
-  fprintf(f, "\t\t__ESBMC_atomic_end();\n");
+  w_printf(f, "\t\t}\n");
+  w_printf(f, "\t\tif (state_stats)\n");
+  w_printf(f, "\t\t\t%s_visited_states[%s_statevar]++;\n\n", prefix, prefix);
+  w_printf(f, "\t\t/* __ESBMC_really_atomic_end(); */\n");
+  w_printf(f, "\t\t__ESBMC_atomic_end();\n");
 
-  return g_num_states;
+  return x->nstates;
 }
 
-static void print_c_buchi_body_tail(FILE *f)
+/* Same automaton as print_c_buchi_body(), as constant tables: a letter
+ * for which the current state has no successor is cut by the lookup of
+ * print_c_step_tables(), then the choice selects one of the edges of the
+ * state, i.e. one of its groups of transitions to a same target, and the
+ * edge is enabled if one of its cubes matches the bits of _sym_to_idx(). */
+static int print_c_table_body(Writer *f, const BIndex *x, int sym_id,
+                              const char *prefix)
 {
-  fprintf(f, "\
+  BTrans *t;
+  int i, j, ncubes = 0, max_cubes = 0;
+
+  w_printf(f, "/* edges of a state s: edge_off[s] .. edge_off[s+1]-1 */\n");
+  w_printf(f, "static const unsigned int %s_edge_off[%d] = {", prefix, x->nstates + 1);
+  for (i = 0; i <= x->nstates; i++)
+    w_printf(f, "%s%d,", i % 16 ? " " : "\n  ", x->group_off[i]);
+  w_printf(f, "\n};\n\n");
+
+  w_printf(f, "static const %s_state %s_edge_to[%d] = {", prefix, prefix,
+           x->group_off[x->nstates] + 1);
+  for (j = 0; j < x->group_off[x->nstates]; j++) {
+    w_printf(f, "\n  ");
+    print_state_name(f, x->groups[j].to, prefix);
+    w_printf(f, ",");
+  }
+  w_printf(f, "\n};\n\n");
+
+  /* the cubes of an edge are the guards of its transitions */
+  w_printf(f, "/* cubes of an edge e: cube_off[e] .. cube_off[e+1]-1 */\n");
+  w_printf(f, "static const unsigned int %s_cube_off[%d] = {", prefix,
+           x->group_off[x->nstates] + 1);
+  for (j = 0; j <= x->group_off[x->nstates]; j++) {
+    w_printf(f, "%s%d,", j % 16 ? " " : "\n  ", ncubes);
+    if (j < x->group_off[x->nstates]) {
+      ncubes += x->groups[j].count;
+      if (x->groups[j].count > max_cubes)
+        max_cubes = x->groups[j].count;
+    }
+  }
+  w_printf(f, "\n};\n\n");
+
+  /* the cube c holds if (idx & cube_care[c]) == cube_val[c] */
+  w_printf(f, "static const unsigned int %s_cube_care[%d] = {", prefix, ncubes + 1);
+  for (j = 0; j < ncubes; j++) {
+    t = x->trans[j];
+    w_printf(f, "%s%#x,", j % 8 ? " " : "\n  ",
+             (t->pos ? c_sym_mask(t->pos, sym_id) : 0) |
+             (t->neg ? c_sym_mask(t->neg, sym_id) : 0));
+  }
+  w_printf(f, "\n};\n\n");
+  w_printf(f, "static const unsigned int %s_cube_val[%d] = {", prefix, ncubes + 1);
+  for (j = 0; j < ncubes; j++) {
+    t = x->trans[j];
+    w_printf(f, "%s%#x,", j % 8 ? " " : "\n  ",
+             t->pos ? c_sym_mask(t->pos, sym_id) : 0);
+  }
+  w_printf(f, "\n};\n\n");
+
+  w_printf(f, "#define %s_MAX_CUBES %d\n\n", prefix, max_cubes);
+
+  w_printf(f, "void\nltl2ba_fsm(bool state_stats, unsigned int num_iters)\n{\n");
+  w_printf(f, "\tunsigned int choice;\n");
+  w_printf(f, "\tunsigned int iters;\n");
+  w_printf(f, "\tunsigned int e, k, n;\n");
+  w_printf(f, "\tunsigned int idx;\n");
+  w_printf(f, "\t_Bool enabled;\n\n");
+
+  w_printf(f, "\t/* Original formula:\n\t * ");
+  put_uform(f);
+  w_printf(f, "\n\t */\n\n");
+
+  w_printf(f, "\tfor (iters = 0; iters < num_iters; iters++) {\n");
+  w_printf(f, "\t\tchoice = nondet_uint();\n\n");
+  w_printf(f, "\t\t__ESBMC_atomic_begin();\n\n");
+  w_printf(f, "\t\tidx = %s_sym_to_idx();\n", prefix);
+  w_printf(f, "\t\t__ESBMC_assume(%s_state_is_viable(idx, %s_statevar));\n",
+           prefix, prefix);
+  w_printf(f, "\t\t__ESBMC_assume(choice < %s_edge_off[%s_statevar + 1] - %s_edge_off[%s_statevar]);\n",
+           prefix, prefix, prefix, prefix);
+  w_printf(f, "\t\te = %s_edge_off[%s_statevar] + choice;\n", prefix, prefix);
+  w_printf(f, "\t\tn = %s_cube_off[e + 1] - %s_cube_off[e];\n", prefix, prefix);
+  w_printf(f, "\t\tenabled = 0;\n");
+  w_printf(f, "\t\tfor (k = 0; k < %s_MAX_CUBES; k++)\n", prefix);
+  w_printf(f, "\t\t\tenabled |= k < n && (idx & %s_cube_care[%s_cube_off[e] + k]) == %s_cube_val[%s_cube_off[e] + k];\n",
+           prefix, prefix, prefix, prefix);
+  w_printf(f, "\t\t__ESBMC_assume(enabled);\n");
+  w_printf(f, "\t\t%s_statevar = %s_edge_to[e];\n\n", prefix, prefix);
+
+  w_printf(f, "\t\tif (state_stats)\n");
+  w_printf(f, "\t\t\t%s_visited_states[%s_statevar]++;\n\n", prefix, prefix);
+  w_printf(f, "\t\t/* __ESBMC_really_atomic_end(); */\n");
+  w_printf(f, "\t\t__ESBMC_atomic_end();\n");
+
+  return x->nstates;
+}
+
+static void print_c_buchi_body_tail(Writer *f)
+{
+  w_printf(f, "\
 		/* __ESBMC_switch_from_monitor(); */\n\
 	}\n\
 \n\
@@ -993,9 +1491,9 @@ static void print_c_buchi_body_tail(FILE *f)
 ");
 }
 
-static void print_c_buchi_util_funcs(FILE *f, const char *prefix)
+static void print_c_buchi_util_funcs(Writer *f, const char *prefix)
 {
-  fprintf(f, "\
+  w_printf(f, "\
 #ifndef LTL_PREFIX_BOUND\n\
 #define LTL_PREFIX_BOUND 2147483648\n\
 #endif\n\
@@ -1025,124 +1523,491 @@ pthread_t ltl2ba_start_monitor(void)\n\
 ");
 }
 
-static int increment_symbol_set(int *s, int sym_id)
+/* distinct guards of the transitions, a null set standing for the empty one */
+struct guards {
+  int count;
+  int **pos, **neg;
+};
+
+static void collect_guards(const Buchi *b, const BIndex *x, struct guards *gd)
 {
-  int i,j;
-  for(i=0; i< sym_id && in_set(s, i); i++);
-  if (i==sym_id)
+  BTrans *t;
+  int i, j;
+
+  gd->pos = (int **)tl_emalloc((x->ntrans + 1) * sizeof(int *));
+  gd->neg = (int **)tl_emalloc((x->ntrans + 1) * sizeof(int *));
+  gd->count = 0;
+  for (j = 0; j < x->ntrans; j++) {
+      t = x->trans[j];
+      for(i = 0; i < gd->count; i++)
+        if((t->pos ? gd->pos[i] && same_sets(t->pos, gd->pos[i], b->sz.sym_size) : !gd->pos[i]) &&
+           (t->neg ? gd->neg[i] && same_sets(t->neg, gd->neg[i], b->sz.sym_size) : !gd->neg[i]))
+          break;
+      if(i == gd->count) {
+        gd->pos[gd->count] = t->pos;
+        gd->neg[gd->count++] = t->neg;
+      }
+    }
+}
+
+/* returns 1 if the guard holds on all the letters of the cube, -1 if it
+ * holds on none of them, and 0 otherwise */
+static int guard_on_cube(int *pos, int *neg, const Cube *c, int sym_size)
+{
+  if((pos && !empty_intersect_sets(pos, c->fls, sym_size)) ||
+     (neg && !empty_intersect_sets(neg, c->tru, sym_size)))
+    return -1;
+  if((pos && !included_set(pos, c->tru, sym_size)) ||
+     (neg && !included_set(neg, c->fls, sym_size)))
     return 0;
-  for(j=0;j<i;j++)
-    rem_set(s,j);
-  add_set(s,i);
-  return !0;
+  return 1;
+}
+
+/* returns a hash table of at least 2 * n slots, all free, and sets hmask
+ * to its size minus one */
+static int *new_slots(int n, int *hmask)
+{
+  int *slot;
+  for(*hmask = 1; *hmask < 2 * n; *hmask <<= 1)
+    ;
+  slot = (int *)tl_emalloc(*hmask * sizeof(int));
+  memset(slot, -1, *hmask * sizeof(int));
+  (*hmask)--;
+  return slot;
+}
+
+/* returns the class of the letters enabling the guards 'sig', creating it
+ * if needed, and adds the cube c to it */
+static int letter_class(struct letter_classes *lc, int *sig, int sig_size,
+                        const Cube *c, int sym_size)
+{
+  int i, k;
+  unsigned h = hash_set(sig, sig_size);
+  Cube *c1;
+
+  if(2 * lc->count >= lc->hmask) { /* rebuilds the index, larger */
+    if(lc->slot)
+      tfree(lc->slot);
+    lc->slot = new_slots(2 * lc->count + 8, &lc->hmask);
+    for(i = 0; i < lc->count; i++) {
+      for(k = lc->hash[i] & lc->hmask; lc->slot[k] >= 0; k = (k + 1) & lc->hmask)
+        ;
+      lc->slot[k] = i;
+    }
+  }
+  for(k = h & lc->hmask; (i = lc->slot[k]) >= 0; k = (k + 1) & lc->hmask)
+    if(lc->hash[i] == h && same_sets(sig, lc->sig[i], sig_size))
+      break;
+  if(i < 0) {
+    i = lc->slot[k] = lc->count;
+    if(lc->count == lc->size) { /* grows the tables */
+      int size = 2 * lc->size + 8;
+      int **s = (int **)tl_emalloc(size * sizeof(int *));
+      int **r = (int **)tl_emalloc(size * sizeof(int *));
+      Cube **cu = (Cube **)tl_emalloc(size * sizeof(Cube *));
+      Cube **la = (Cube **)tl_emalloc(size * sizeof(Cube *));
+      unsigned *ha = (unsigned *)tl_emalloc(size * sizeof(unsigned));
+      if(lc->size) {
+        memcpy(s, lc->sig, lc->count * sizeof(int *));
+        memcpy(r, lc->rep, lc->count * sizeof(int *));
+        memcpy(cu, lc->cubes, lc->count * sizeof(Cube *));
+        memcpy(la, lc->last, lc->count * sizeof(Cube *));
+        memcpy(ha, lc->hash, lc->count * sizeof(unsigned));
+        tfree(lc->sig);
+        tfree(lc->rep);
+        tfree(lc->cubes);
+        tfree(lc->last);
+        tfree(lc->hash);
+      }
+      lc->sig = s;
+      lc->rep = r;
+      lc->cubes = cu;
+      lc->last = la;
+      lc->hash = ha;
+      lc->size = size;
+    }
+    lc->sig[i] = dup_set(sig, sig_size);
+    lc->rep[i] = dup_set(c->tru, sym_size); /* the other symbols are false */
+    lc->cubes[i] = lc->last[i] = (Cube *)0;
+    lc->hash[i] = h;
+    lc->count++;
+  }
+  c1 = (Cube *)tl_emalloc(sizeof(Cube));
+  c1->tru = dup_set(c->tru, sym_size);
+  c1->fls = dup_set(c->fls, sym_size);
+  c1->nxt = (Cube *)0;
+  if(lc->last[i])
+    lc->last[i]->nxt = c1;
+  else
+    lc->cubes[i] = c1;
+  lc->last[i] = c1;
+  return i;
+}
+
+/* Builds the decision tree of the letters of the cube c, whose symbols
+ * below 'below' are all free. The symbols are tested from the highest one
+ * down, the value false first, so that the leaves are met by increasing
+ * smallest letter; a symbol is only tested if a guard still depends on it. */
+static LNode *split_letters(struct letter_classes *lc, const struct guards *gd,
+                            Cube *c, int below, int sym_size, Status *stop)
+{
+  LNode *local[64], **st = local, *n, *tree, **to = &tree;
+  int sp = 0, size = 64, i, sig_size = LTL2BA_SET_SIZE(gd->count);
+  int *sig, *mention;
+
+  for(;;) { /* builds *to, the nodes being tested waiting on st */
+    if((*stop = check_stop()))
+      break;
+    n = *to = (LNode *)tl_emalloc(sizeof(LNode));
+    sig = make_set(LTL2BA_EMPTY_SET, sig_size);
+    mention = make_set(LTL2BA_EMPTY_SET, sym_size);
+    for(i = 0; i < gd->count; i++)
+      switch(guard_on_cube(gd->pos[i], gd->neg[i], c, sym_size)) {
+      case 1:
+        add_set(sig, i);
+        break;
+      case 0: /* the guard still depends on some of the free symbols */
+        if(gd->pos[i]) merge_sets(mention, gd->pos[i], sym_size);
+        if(gd->neg[i]) merge_sets(mention, gd->neg[i], sym_size);
+        break;
+      }
+    for(i = below - 1; i >= 0 && !in_set(mention, i); i--)
+      ;
+    if(i < 0) { /* all the letters of c enable the same guards */
+      n->sym = -1;
+      n->cls = letter_class(lc, sig, sig_size, c, sym_size);
+    }
+    tfree(sig);
+    tfree(mention);
+    if(i >= 0) { /* the value false first */
+      n->sym = i;
+      add_set(c->fls, i);
+      STACK_PUSH(st, sp, size, local, n);
+      to = &n->lo;
+      below = i;
+      continue;
+    }
+
+    for(; sp && in_set(c->tru, st[sp - 1]->sym); sp--) /* both done */
+      rem_set(c->tru, st[sp - 1]->sym);
+    if(!sp)
+      break;
+    n = st[sp - 1];
+    rem_set(c->fls, n->sym);
+    add_set(c->tru, n->sym);
+    to = &n->hi;
+    below = n->sym;
+  }
+  STACK_FREE(st, local);
+  return tree;
+}
+
+/* computes the classes of the letters over the symbols 0 .. sym_id-1, unless
+ * the translation is stopped */
+static Status make_letter_classes(const Buchi *b, const BIndex *x, int sym_id,
+                                  struct letter_classes *lc)
+{
+  struct guards gd;
+  Cube c;
+  Status stop;
+
+  memset(lc, 0, sizeof(*lc));
+  collect_guards(b, x, &gd);
+  c.tru = make_set(LTL2BA_EMPTY_SET, b->sz.sym_size);
+  c.fls = make_set(LTL2BA_EMPTY_SET, b->sz.sym_size);
+  lc->tree = split_letters(lc, &gd, &c, sym_id, b->sz.sym_size, &stop);
+  if(lc->size) {
+    tfree(lc->last);
+    tfree(lc->hash);
+    tfree(lc->slot);
+    lc->last = (Cube **)0;
+    lc->hash = (unsigned *)0;
+    lc->slot = (int *)0;
+  }
+  tfree(c.tru);
+  tfree(c.fls);
+  tfree(gd.pos);
+  tfree(gd.neg);
+  return stop;
+}
+
+/* returns the class of the letter whose bit i is the value of the symbol i */
+static int class_of_letter(const struct letter_classes *lc, unsigned letter)
+{
+  const LNode *n = lc->tree;
+  while(n->sym != -1)
+    n = ((letter >> n->sym) & 1) ? n->hi : n->lo;
+  return n->cls;
+}
+
+static void print_letter_symbol(Writer *f, const Symbol *const *sym_table,
+                                const Cexprtab *cexpr, int i)
+{
+  print_sym_name(f, sym_table[i], cexpr);
+}
+
+/* prints the cubes covering a class of letters */
+static void print_letter_class(Writer *f, const Symbol *const *sym_table,
+                               const Cexprtab *cexpr, const Cube *c,
+                               int sym_id)
+{
+  int i, first;
+  for(; c; c = c->nxt) {
+    first = !0;
+    for(i=0; i<sym_id; i++)
+      if(in_set(c->tru, i) || in_set(c->fls, i)) {
+        if (!first)
+          w_printf(f,"&");
+        first = 0;
+        if(in_set(c->fls, i))
+          w_printf(f,"!");
+        print_letter_symbol(f, sym_table, cexpr, i);
+      }
+    if(first)
+      w_printf(f,"1");
+    w_printf(f, c->nxt ? " | " : "\n");
+  }
+}
+
+/* scratch space for reachability(), shared by all the matrices of a
+ * same size */
+struct closure_work {
+  int n, size;
+  SccWork scc_work;
+  int *off, *succ, *roots, *scc;
+  int **reach;   /* states reachable from each component */
+  int **members; /* states of each component */
+};
+
+static void closure_work_init(struct closure_work *w, int n)
+{
+  int i;
+  w->n = n;
+  w->size = LTL2BA_SET_SIZE(n);
+  scc_work_init(&w->scc_work, n);
+  w->off = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->succ = (int *)tl_emalloc((n * n + 1) * sizeof(int));
+  w->roots = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->scc = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->reach = (int **)tl_emalloc((n + 1) * sizeof(int *));
+  w->members = (int **)tl_emalloc((n + 1) * sizeof(int *));
+  for(i = 0; i < n; i++) {
+    w->roots[i] = i;
+    w->reach[i] = new_set(w->size);
+    w->members[i] = new_set(w->size);
+  }
+}
+
+static void closure_work_free(struct closure_work *w)
+{
+  int i;
+  for(i = 0; i < w->n; i++) {
+    tfree(w->reach[i]);
+    tfree(w->members[i]);
+  }
+  scc_work_free(&w->scc_work);
+  tfree(w->off);
+  tfree(w->succ);
+  tfree(w->roots);
+  tfree(w->scc);
+  tfree(w->reach);
+  tfree(w->members);
 }
 
-static int * reachability(int * m, int rows)
+static void reachability(struct closure_work *w, const int * m, int rows, int * r)
 {
-/* This function takes a rows * cols integer array and repeatedly applies the transformation
- * M <- M*M + M to a fixed point, where the elementwise + operator is boolean OR and the * is
- * boolean AND. The idea is that the original matrix is a transition matrix, and the reachability
- * matrix gives the set of states reachable from a given initial (row) state.
+/* This function takes a rows * rows transition matrix and returns its transitive closure,
+ * i.e. the matrix of the states reachable in one step or more from a given initial (row) state.
+ * All the states of a strongly connected component reach the same states: the components
+ * are completed in reverse topological order, so each one merges the bitsets of the
+ * components it leads to, which are already known.
  */
-  int *t1 = (int*)tl_emalloc(rows*rows*sizeof(int));
-  int *t2 = (int*)tl_emalloc(rows*rows*sizeof(int));
-  int *m1 = m;
-  int *m2 =t1;
-  int i, r, c;
-  int going = !0;
-
-  while (going) {
-    going = 0;
-    for(r=0;r<rows;r++) {
-      for(c=0;c<rows;c++) {
-        m2[r*rows+c] = 0;
-        for (i=0;i<rows;i++) {
-          m2[r*rows+c] |= m1[r*rows+i]&m1[i*rows+c]; }
-        m2[r*rows+c] |=  m1[r*rows+c];
-        going |= (m2[r*rows+c] !=  m1[r*rows+c]); } }
-    m1 = m2;
-    m2 = (m1==t1)?t2:t1; }
-  tfree(m2);
-  return m1; }
-
-static int *pess_recurse1(const struct pess_data *d, Slist* sl, int depth);
-
-static int* pess_recurse3(const struct pess_data *d, int i, int depth) {
-/* Okay, we've now pessimistically picked a set and optimistically picked
- * an element within it. So we just have to iterate the depth */
-  depth--;
-  if (depth == 0)
-    return make_set(i, d->state_size);
-  return pess_recurse1(d, d->tr[i], depth);
-}
-
-static int* pess_recurse2(const struct pess_data *d, int *s, int depth) {
-/* Optimistically pick an element out of the set */
+  int i, c, v, u, e, nscc;
+
+  assert(rows == w->n);
+  for(v = 0, e = 0; v < rows; v++) {
+    w->off[v] = e;
+    for(u = 0; u < rows; u++)
+      if(m[v*rows+u])
+        w->succ[e++] = u;
+  }
+  w->off[rows] = e;
+  nscc = scc_tarjan(&w->scc_work, rows, w->off, w->succ, w->roots, rows, w->scc);
+
+  for(c = 0; c < nscc; c++) {
+    clear_set(w->reach[c], w->size);
+    clear_set(w->members[c], w->size);
+  }
+  for(v = 0; v < rows; v++)
+    add_set(w->members[w->scc[v]], v);
+  for(c = 0; c < nscc; c++) /* successors first */
+    for(v = 0; v < rows; v++) {
+      if(w->scc[v] != c)
+        continue;
+      for(e = w->off[v]; e < w->off[v + 1]; e++) {
+        i = w->scc[w->succ[e]];
+        if(i == c) /* c is a cycle */
+          merge_sets(w->reach[c], w->members[c], w->size);
+        else {
+          add_set(w->reach[c], w->succ[e]);
+          merge_sets(w->reach[c], w->reach[i], w->size);
+        }
+      }
+    }
+
+  for(v = 0; v < rows; v++)
+    for(u = 0; u < rows; u++)
+      r[v*rows+u] = in_set(w->reach[w->scc[v]], u) ? 1 : 0;
+}
+
+/* Analysis of one class of letters, done in parallel with the other ones:
+ * nothing here allocates, the buffers are set up by the main thread. */
+struct letter_work {
+  int cls;
+  int *transition_matrix, *reach;
+  int **targets;          /* states reached on the letters from each state */
+  int *accepting_cycles, *accepting_states;
+};
+
+struct behaviour_thread {
+  pthread_t thread;
+  const Buchi *b;
+  const BIndex *x;
+  const struct letter_classes *lc;
+  int state_count, state_size;
+  struct closure_work closure;
+  int *optimistic_transition;  /* transitions on the letters seen by the thread */
+  struct letter_work *work;
+  int count, step;             /* analyses work[0], work[step], ... */
+};
+
+static void analyse_letter_class(struct behaviour_thread *th, struct letter_work *w)
+{
+  const Buchi *b = th->b;
+  const BIndex *x = th->x;
+  int state_count = th->state_count, state_size = th->state_size;
+  int *a = th->lc->rep[w->cls];
+  BState *s;
+  BTrans *t;
+  int i, j, r, c;
+
+  for (i=0;i<state_count*state_count;i++)   /* Loop over states, clearing transition matrix for this character */
+    w->transition_matrix[i]=0;              /* END loop over states */
+  for (i = 0; i < x->nstates; i++) {                          /* Loop over states */
+    int *working_set = w->targets[i];
+    s = x->states[i];
+    (void)clear_set(working_set,state_size);                    /* clear transition targets for this state and character */
+    for(j = x->trans_off[i]; j < x->trans_off[i + 1]; j++) {   /* Loop over transitions */
+      t = x->trans[j];
+      if ((!t->pos || included_set(t->pos,a,b->sz.sym_size)) && (!t->neg || empty_intersect_sets(t->neg,a,b->sz.sym_size))) {  /* Tests TRUE if this transition is enabled on this character of the alphabet */
+        add_set(working_set,t->to->label);                                      /* update working set of transition targets enabled for this character on this state */
+        w->transition_matrix[(s->label)*state_count + (t->to->label)] = 1;      /* update per-character transition matrix */
+        th->optimistic_transition[(s->label)*state_count + (t->to->label)] = 1; /* update optimistic (any character) transition matrix */
+      }
+    }                                                           /* END Loop over transitions */
+  }                                                             /* END Loop over states */
+
+  reachability(&th->closure, w->transition_matrix, state_count, w->reach);
+
+  clear_set(w->accepting_cycles,state_size);
+  for (s = b->bstates->prv; s != b->bstates; s = s->prv)
+    if((s->final == b->accept || s -> id == 0) && w->reach[(s->label)*(state_count+1)])
+      add_set(w->accepting_cycles,s->label);
+  clear_set(w->accepting_states,state_size);
+  for (r=0;r<state_count;r++)
+    for (c=0; c<state_count;c++)
+      if(w->reach[r*state_count+c] && in_set(w->accepting_cycles,c))
+        add_set(w->accepting_states,r);
+}
+
+static void *behaviour_thread_main(void *arg)
+{
+  struct behaviour_thread *th = (struct behaviour_thread *)arg;
   int i;
-  int *t;
-  int *reach=make_set(LTL2BA_EMPTY_SET, d->state_size);
-  for(i = 0; i < d->state_count; i++)
-    if (in_set(s, i)) {
-      merge_sets(reach,
-                 t=pess_recurse3(d, i, depth),
-                 d->state_size);
-      tfree(t); }
-  return reach;
+  for (i = 0; i < th->count; i += th->step)
+    analyse_letter_class(th, &th->work[i]);
+  return NULL;
 }
 
-static int *pess_recurse1(const struct pess_data *d, Slist* sl, int depth) {
-/* Pessimistically pick a set out of p->slist */
-  int *reach = dup_set(d->full_state_set, d->state_size);
-  int *t, *t1;
-  while (sl) {
-    reach = intersect_sets(t1=reach,
-                           t=pess_recurse2(d, sl->set, depth),
-                           d->state_size);
-    tfree(t);
-    tfree(t1);
-    sl = sl->nxt; }
-  return reach;
+/* number of threads analysing the letter classes */
+static int behaviour_thread_count(int classes)
+{
+  long n = thread_limit();
+  if (n == 0)
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > classes)
+    n = classes;
+  return n < 1 ? 1 : (int)n;
 }
 
 /* We are looking for states which are reachable down _all_ the imposed Slist
- * elements. So, the one-step reachable states are simply the intersection of
- * all the Slist elements. The two-step reachable states are those for which we
- * can pick an element of each slist element and replace it with with the target
- * slist, such that the state is in the intersection of all of the new slists.
+ * elements: the environment picks a set, the automaton picks a state in it.
+ * So, the one-step reachable states are simply the intersection of all the
+ * Slist elements, and the states reachable in d steps from st are those which
+ * are, for each Slist element of st, reachable in d-1 steps from one of its
+ * states. This is computed for all the states at once, one step at a time,
+ * up to 'depth' steps or to a fixpoint, as each step only depends on the
+ * previous one. Returns the sets of the states reachable from each state.
  */
-static int * pess_reach(Slist **tr, int st, int depth, int state_count, int state_size) {
-  int i;
-  struct pess_data d;
-  d.state_count = state_count;
-  d.state_size = state_size;
-  d.full_state_set = make_set(LTL2BA_EMPTY_SET, d.state_size);
-  d.tr = tr;
-  for(i=0; i < d.state_count; i++)
-    add_set(d.full_state_set, i);
-  return pess_recurse1(&d, tr[st], depth);
+static int ** pess_reach(Slist **tr, int depth, int state_count, int state_size) {
+  int **reach = (int**)tl_emalloc(state_count*sizeof(int*));
+  int **prev = (int**)tl_emalloc(state_count*sizeof(int*));
+  int **tmp;
+  int *full = make_set(LTL2BA_EMPTY_SET, state_size);
+  int *u = new_set(state_size);
+  int st, i, d, going = !0;
+  Slist *sl;
+
+  for (i=0; i<state_count; i++)
+    add_set(full, i);
+  for (st=0; st<state_count; st++) {     /* one step */
+    reach[st] = dup_set(full, state_size);
+    prev[st] = new_set(state_size);
+    for (sl=tr[st]; sl; sl=sl->nxt)
+      for (i=0; i<state_size; i++)
+        reach[st][i] &= sl->set[i]; }
+
+  for (d=1; d<depth && going; d++) {     /* one more step */
+    tmp = prev; prev = reach; reach = tmp;
+    going = 0;
+    for (st=0; st<state_count; st++) {
+      copy_set(full, reach[st], state_size);
+      for (sl=tr[st]; sl; sl=sl->nxt) {
+        clear_set(u, state_size);
+        for (i=0; i<state_count; i++)
+          if (in_set(sl->set, i))
+            merge_sets(u, prev[i], state_size);
+        for (i=0; i<state_size; i++)
+          reach[st][i] &= u[i]; }
+      going |= !same_sets(reach[st], prev[st], state_size); } }
+
+  for (st=0; st<state_count; st++)
+    tfree(prev[st]);
+  tfree(prev);
+  tfree(full);
+  tfree(u);
+  return reach;
 }
 
-static void print_behaviours(const Buchi *b, FILE *f,
-                             const char *const *sym_table,
-                             const Cexprtab *cexpr, int sym_id,
-                             struct accept_sets *as)
+/* returns why the analysis of the letters has stopped, if it has */
+static Status print_behaviours(const Buchi *b, const BIndex *x, Writer *f,
+                               const Symbol *const *sym_table,
+                               const Cexprtab *cexpr, int sym_id,
+                               struct accept_sets *as)
 {
   BState *s;
   BTrans *t;
-  int cex;
-  int *a;
-  int *transition_matrix, *optimistic_transition;
+  int *optimistic_transition;
   Slist **pessimistic_transition, *set_list;
-  int *working_set, *full_state_set;
+  int *full_state_set;
   int i, j, k;
-  int stut_accept_idx;
+  int first, nthreads, started, nwork;
+  struct behaviour_thread *threads;
+  struct letter_work *work;
   int state_count = 0;
   int state_size;
-
-  /* Allocate a set of sets, each representing the accepting states for each
-   * input symbol combination */
-  as->stutter_accept_table = tl_emalloc(sizeof(int *) * (2<<sym_id) * (2<<sym_id));
-  stut_accept_idx = 0;
+  struct closure_work closure;
+  Status status = LTL2BA_OK;
 
   /*
   if (bstates->nxt == bstates) {
@@ -1151,48 +2016,41 @@ static void print_behaviours(const Buchi *b, FILE *f,
   } */
 
   /* Horribly, if there is a state with id == 0, it can has a TRUE transition to itself,
-   * which may not be explicit . So we jam this in. It is also (magically) an
-   * accepting state                                                           */
-  {
-    int going = !0;
-    for (s = b->bstates->prv; s != b->bstates; s = s->prv) {
-      if (s -> id == 0) {
-        for(t = s->trans->nxt; t != s -> trans; t = t->nxt) {
-          if ( !t->pos && ! t->neg)
-            going = 0;
-        }
-        if (going) {
-        /* It's missing so jam it in */
-          BTrans *t2 = (BTrans*)tl_emalloc(sizeof(BTrans));
-          t2->nxt = s->trans->nxt;
-          s->trans->nxt = t2;
-          t2->pos=(int*)0;
-          t2->neg=(int*)0;
-          t2->to = s;
-        }
-      }
-    }
-  }
+   * which may not be explicit. The index x has it. It is also (magically) an
+   * accepting state. The labels of the states are their indexes in x.        */
 
-  fprintf(f,"States:\nlabel\tid\tfinal\n");
+  w_printf(f,"States:\nlabel\tid\tfinal\n");
   for (s = b->bstates->prv; s != b->bstates; s = s->prv) {   /* Loop over states */
-    s -> label = state_count;
     state_count++;
-    fprintf(f,"%d\t",s->label);
+    w_printf(f,"%d\t",s->label);
     print_dot_state_name(f, b, s);
     /* Horribly, the correct test for an accepting state is
      *     s->final == accept || s -> id == 0
      *     Here, "final" is a VARIABLE and the state with id=0 is magic       */
-    fprintf(f,"\t%d\n",s->final == b->accept || s -> id == 0); } /* END Loop over states */
-  fprintf(f,"\nSymbol table:\nid\tsymbol\t\t\tcexpr\n");
+    w_printf(f,"\t%d\n",s->final == b->accept || s -> id == 0); } /* END Loop over states */
+  w_printf(f,"\nSymbol table:\nid\tsymbol\t\t\tcexpr\n");
+  /*
+  for (i=0; i<cexpr->cexpr_idx; i++)
+    printf("%d\t%s\n",i,cexpr->cexpr_expr_table[i]);
+  fprintf(tl_out,"\n"); */
+
+  for(i=0; i<sym_id; i++) {
+    w_printf(f, "%d\t%s",i,sym_table[i]?sym_table[i]->name:"");
+    if (sym_table[i] && sym_table[i]->kind == LTL2BA_SYM_CEXPR)
+      w_printf(f, "\t{ %s }\n", cexpr->cexpr_expr_table[sym_table[i]->cexpr]);
+    else
+      w_printf(f, "\n"); }
+
+  /* The letters enabling the same transitions behave the same: they are
+   * analysed once per class, through the smallest letter of the class. */
+  if ((status = make_letter_classes(b, x, sym_id, &as->classes)))
+    return status;
+
   state_size = LTL2BA_SET_SIZE(state_count);
   full_state_set = make_set(LTL2BA_EMPTY_SET,state_size);
   for(i=0;i<state_count; i++)
     add_set(full_state_set,i);
 
-  /* transition_matrix is a per symbol matrix of permitted transitions */
-  transition_matrix = (int*) tl_emalloc(state_count*state_count*sizeof(int));
-
   /* optimistic_transition is the union of all transition_matricies,
   // i.e. transitions permitted under some symbol */
   optimistic_transition = (int*) tl_emalloc(state_count*state_count*sizeof(int));
@@ -1206,154 +2064,167 @@ static void print_behaviours(const Buchi *b, FILE *f,
   for (i=0;i<state_count;i++) {
     pessimistic_transition[i] = (Slist*)tl_emalloc(sizeof(Slist));
     pessimistic_transition[i]->set = dup_set(full_state_set, state_size);
+    pessimistic_transition[i]->hash = hash_set(full_state_set, state_size);
     pessimistic_transition[i]->nxt = (Slist*)0; }
-  working_set = make_set(LTL2BA_EMPTY_SET,state_size);
 
-  /*
-  for (i=0; i<cexpr->cexpr_idx; i++)
-    printf("%d\t%s\n",i,cexpr->cexpr_expr_table[i]);
-  fprintf(tl_out,"\n"); */
-
-  for(i=0; i<sym_id; i++) {
-    fprintf(f, "%d\t%s",i,sym_table[i]?sym_table[i]:"");
-    if (sym_table[i] && sscanf(sym_table[i],"_ltl2ba_cexpr_%d_status",&cex)==1)
-      /* Yes, scanning for a match here is horrid DAN */
-      fprintf(f, "\t{ %s }\n", cexpr->cexpr_expr_table[cex]);
-    else
-      fprintf(f, "\n"); }
-
-  fprintf(f,"\nStuttering:\n\n");
-  a=make_set(LTL2BA_EMPTY_SET,b->sz.sym_size);
-  do {                                     /* Loop over alphabet */
-    fprintf(f,"\n");
-    for (i=0;i<state_count*state_count;i++)   /* Loop over states, clearing transition matrix for this character */
-      transition_matrix[i]=0;                 /* END loop over states */
-    /* print_sym_set(a, sym_size); fprintf(tl_out,"\n"); */
-    {                                         /* Display the current symbol */
-      int first = !0;
-      int i, cex;
-      for(i=0; i<sym_id; i++) {
-        if (!first)
-          fprintf(f,"&");
-        first = 0;
-        if(!in_set(a,i))
-          fprintf(f,"!");
-        if (sscanf(sym_table[i],"_ltl2ba_cexpr_%d_status",&cex)==1)
-          fprintf(f, "{%s}", cexpr->cexpr_expr_table[cex]);
-        else
-          fprintf(f, "%s",sym_table[i]); }
-      fprintf(f,"\n");
-    }
-
-    for (s = b->bstates->prv; s != b->bstates; s = s->prv) {   /* Loop over states */
-      (void)clear_set(working_set,b->sz.sym_size);                    /* clear transition targets for this state and character */
-      for(t = s->trans->nxt; t != s -> trans; t = t->nxt) {       /* Loop over transitions */
-#if 0
-        fprintf(f,"%d--[+",s->label);
-        if(t->pos) print_sym_set(f, t->pos, sym_size);
-         fprintf(f," -");
-        if(t->neg) print_sym_set(f, t->neg, sym_size);
-        fprintf(f,"]--> %d\t",t->to->label);
-        fprintf(f, "%s\n", (!t->neg || empty_intersect_sets(t->neg,a,sym_size))?
-                                   ((!t->pos || included_set(t->pos,a,sym_size))?"active":""):"suppressed");
-#endif
-
-        if ((!t->pos || included_set(t->pos,a,b->sz.sym_size)) && (!t->neg || empty_intersect_sets(t->neg,a,b->sz.sym_size))) {  /* Tests TRUE if this transition is enabled on this character of the alphabet */
-          add_set(working_set,t->to->label);                                  /* update working set of transition targets enabled for this character on this state */
-          transition_matrix[(s->label)*state_count + (t->to->label)] = 1;     /* update per-character transition matrix */
-          optimistic_transition[(s->label)*state_count + (t->to->label)] = 1; /* update optimistic (any character) transition matrix */
-          }
-        }                                                     /* END Lop over transitions */
+  /* Allocate a set of sets, each representing the accepting states for each
+   * class of input symbol combinations */
+  as->stutter_accept_table = tl_emalloc(sizeof(int *) * as->classes.count);
+
+  /* The classes are analysed in batches, each thread taking every
+   * nthreads-th class of the batch; the results are then printed and the
+   * pessimistic lists updated in the order of the classes. */
+  nthreads = behaviour_thread_count(as->classes.count);
+  nwork = 4 * nthreads;
+  threads = (struct behaviour_thread *)tl_emalloc(nthreads * sizeof(struct behaviour_thread));
+  for (i = 0; i < nthreads; i++) {
+    threads[i].b = b;
+    threads[i].x = x;
+    threads[i].lc = &as->classes;
+    threads[i].state_count = state_count;
+    threads[i].state_size = state_size;
+    closure_work_init(&threads[i].closure, state_count);
+    /* each thread gathers the transitions on the letters it analyses */
+    threads[i].optimistic_transition = (int*) tl_emalloc(state_count*state_count*sizeof(int));
+    threads[i].step = nthreads; }
+  work = (struct letter_work *)tl_emalloc(nwork * sizeof(struct letter_work));
+  for (i = 0; i < nwork; i++) {
+    work[i].transition_matrix = (int*) tl_emalloc(state_count*state_count*sizeof(int));
+    work[i].reach = (int*) tl_emalloc(state_count*state_count*sizeof(int));
+    work[i].targets = (int**) tl_emalloc(state_count*sizeof(int*));
+    for (j = 0; j < state_count; j++)
+      work[i].targets[j] = new_set(state_size);
+    work[i].accepting_cycles = new_set(state_size); }
+
+  w_printf(f,"\nStuttering:\n\n");
+  for(first = 0; !status && first < as->classes.count; first += nwork) { /* Loop over batches of letter classes */
+    int count = as->classes.count - first;
+    if ((status = check_stop()))
+      break;
+    if (count > nwork)
+      count = nwork;
+    for (k = 0; k < count; k++) {
+      work[k].cls = first + k;
+      /* Allocate a set, representing the accepting states for this class */
+      work[k].accepting_states = as->stutter_accept_table[first + k] = new_set(state_size); }
+    for (i = 0; i < nthreads; i++) {
+      threads[i].work = &work[i];
+      threads[i].count = count - i; }
+    /* the main thread takes the first share */
+    for (i = 1; i < nthreads && i < count; i++)
+      if (pthread_create(&threads[i].thread, NULL, behaviour_thread_main, &threads[i]))
+        break;
+    started = i;
+    for (; i < nthreads && i < count; i++)      /* no more threads: do it here */
+      behaviour_thread_main(&threads[i]);
+    behaviour_thread_main(&threads[0]);
+    for (i = 1; i < started; i++)
+      pthread_join(threads[i].thread, NULL);
+
+    for (k = 0; k < count; k++) {                /* Loop over letter classes */
+      struct letter_work *w = &work[k];
+      w_printf(f,"\n");
+      /* Display the letters of the class */
+      print_letter_class(f, sym_table, cexpr, as->classes.cubes[w->cls], sym_id);
+
+      for (s = b->bstates->prv; s != b->bstates; s = s->prv) {   /* Loop over states */
+        int *working_set = w->targets[s->label];
         {                                                                     /* update pessimistic transition list for this state */
-          set_list=pessimistic_transition[s->label];
+          /* The list is kept free of sets including one another: a new set replaces
+           * the sets including it, and is ignored if it includes one of them. */
+          unsigned hash = hash_set(working_set, state_size);
+          Slist **prev_set, *found = (Slist*)0;
           int add = 1;
-          Slist *prev_set;
-          while (set_list) {                                /* loop over list of pessimistic transitions */
-            if(included_set(working_set,set_list->set, state_size)) {
-              tfree(set_list->set);                                                 /* our new set is smaller than this set already in the list -> replace */
-              set_list->set = dup_set(working_set, state_size); add = 0;
+          for (set_list=pessimistic_transition[s->label]; set_list; set_list=set_list->nxt)
+            if (set_list->hash == hash && same_sets(set_list->set, working_set, state_size))
+              break;                                                              /* already in the list */
+          if (set_list)
+            add = 0;
+          prev_set = &pessimistic_transition[s->label];
+          while (add && *prev_set) {                        /* loop over list of pessimistic transitions */
+            set_list = *prev_set;
+            if (included_set(working_set,set_list->set, state_size)) {
+              if (!found) {                                                         /* our new set is smaller than this set already in the list -> replace */
+                copy_set(working_set, set_list->set, state_size);
+                set_list->hash = hash;
+                found = set_list;
+              } else {                                                              /* ... and drop the other ones */
+                *prev_set = set_list->nxt;
+                tfree(set_list->set);
+                tfree(set_list);
+                continue; }
             } else if (included_set(set_list->set,working_set,state_size)) {
               add = 0;                                                              /* our new set is bigger than this set already in the list -> ignore */
               }
-            prev_set = set_list;
-            set_list = set_list->nxt; }
-          if (add) {                                                              /* Our new set overlaps all existing sets, so add it */
-            prev_set->nxt = (Slist*)tl_emalloc(sizeof(Slist));
-            prev_set->nxt->set = dup_set(working_set, state_size);
-            prev_set->nxt->nxt = (Slist*)0; }
-
-          {                                                                            /* Eliminate duplicate sets in set list */
-            Slist * set_list2 = pessimistic_transition[s->label];
-            while(set_list2) {
-              set_list = set_list2;
-              while(set_list->nxt) {
-                if(same_sets(set_list->nxt->set,set_list2->set,state_size)) {
-                  Slist * drop = set_list->nxt;
-                  set_list->nxt = drop -> nxt;
-                  tfree(drop -> set);
-                  tfree(drop);
-                } else
-                  set_list = set_list->nxt;
-              }
-              set_list2 = set_list2->nxt;
-            }
-          }                                                                      /* END Eliminate duplicate sets in set list */
+            prev_set = &set_list->nxt; }
+          if (add && !found) {                                                    /* Our new set overlaps all existing sets, so add it */
+            *prev_set = (Slist*)tl_emalloc(sizeof(Slist));
+            (*prev_set)->set = dup_set(working_set, state_size);
+            (*prev_set)->hash = hash;
+            (*prev_set)->nxt = (Slist*)0; }
             }                                                                 /* END update pessimistic transition list for this state */
         }                                                   /* END Loop over states */
 
-    fprintf(f,"Transitions:\n");
-    for(i=0; i<state_count; i++) {
-      for(j=0;j<state_count; j++)
-        fprintf(f,"%d\t",transition_matrix[i*state_count + j]);
-      fprintf(f,"\n"); }
-    fprintf(f,"\n");
-
-    int * reach = reachability(transition_matrix, state_count);
-
-    fprintf(f,"Reachability:\n");
-    for(i=0; i<state_count; i++) {
-      for(j=0;j<state_count; j++)
-        fprintf(f,"%d\t",reach[i*state_count + j]);
-      fprintf(f,"\n"); }
-    fprintf(f,"\n");
-    {
-      BState *s2;
-      int r, c;
-      int * accepting_cycles=make_set(LTL2BA_EMPTY_SET,state_size);
-      for (s2 = b->bstates->prv; s2 != b->bstates; s2 = s2->prv)
-        if((s2->final == b->accept || s2 -> id == 0) && reach[(s2->label)*(state_count+1)])
-          add_set(accepting_cycles,s2->label);
-      fprintf(f,"Accepting cycles: ");
-      print_set(f, accepting_cycles,state_size);
-      int * accepting_states=make_set(LTL2BA_EMPTY_SET,state_size);
-      for (r=0;r<state_count;r++)
-        for (c=0; c<state_count;c++) {
-          /* fprintf(tl_out,"\n*** r:%d c:%d reach:%d in_set:%d\n",r,c,reach[r*state_count+c],in_set(accepting_cycles,c)); */
-          if(reach[r*state_count+c] && in_set(accepting_cycles,c))
-            add_set(accepting_states,r); }
-      fprintf(f,"\nAccepting states: ");
-      print_set(f, accepting_states,state_size);
-      fprintf(f,"\n");
-
-      as->stutter_accept_table[stut_accept_idx++] = accepting_states;
-
-      tfree(accepting_cycles);
-    }
-    tfree (reach);
-     } while (increment_symbol_set(a, sym_id));       /* END Loop over alphabet */
-
-  fprintf(f,"\n\nOptimistic transitions:\n");
+      w_printf(f,"Transitions:\n");
+      for(i=0; i<state_count; i++) {
+        for(j=0;j<state_count; j++)
+          w_printf(f,"%d\t",w->transition_matrix[i*state_count + j]);
+        w_printf(f,"\n"); }
+      w_printf(f,"\n");
+
+      w_printf(f,"Reachability:\n");
+      for(i=0; i<state_count; i++) {
+        for(j=0;j<state_count; j++)
+          w_printf(f,"%d\t",w->reach[i*state_count + j]);
+        w_printf(f,"\n"); }
+      w_printf(f,"\n");
+      w_printf(f,"Accepting cycles: ");
+      print_set(f, w->accepting_cycles,state_size);
+      w_printf(f,"\nAccepting states: ");
+      print_set(f, w->accepting_states,state_size);
+      w_printf(f,"\n");
+    }                                                  /* END Loop over letter classes */
+  }                                                    /* END Loop over batches */
+
+  for (i = 0; i < nthreads; i++) {                     /* gather the optimistic transitions */
+    for (j = 0; j < state_count*state_count; j++)
+      optimistic_transition[j] |= threads[i].optimistic_transition[j];
+    tfree(threads[i].optimistic_transition);
+    closure_work_free(&threads[i].closure); }
+  tfree(threads);
+  for (i = 0; i < nwork; i++) {
+    tfree(work[i].transition_matrix);
+    tfree(work[i].reach);
+    for (j = 0; j < state_count; j++)
+      tfree(work[i].targets[j]);
+    tfree(work[i].targets);
+    tfree(work[i].accepting_cycles); }
+  tfree(work);
+  if (status) {
+    for (i = 0; i < state_count; i++)
+      while ((set_list = pessimistic_transition[i])) {
+        pessimistic_transition[i] = set_list->nxt;
+        tfree(set_list->set);
+        tfree(set_list); }
+    tfree(pessimistic_transition);
+    tfree(optimistic_transition);
+    tfree(full_state_set);
+    return status; }
+
+  w_printf(f,"\n\nOptimistic transitions:\n");
   for(i=0; i<state_count; i++) {
     for(j=0;j<state_count; j++)
-      fprintf(f,"%d\t",optimistic_transition[i*state_count + j]);
-    fprintf(f,"\n"); }
+      w_printf(f,"%d\t",optimistic_transition[i*state_count + j]);
+    w_printf(f,"\n"); }
 
-  int *optimistic_reach = reachability(optimistic_transition, state_count);
-  fprintf(f,"Optimistic reachability:\n");
+  int *optimistic_reach = (int*) tl_emalloc(state_count*state_count*sizeof(int));
+  closure_work_init(&closure, state_count);
+  reachability(&closure, optimistic_transition, state_count, optimistic_reach);
+  w_printf(f,"Optimistic reachability:\n");
   for(i=0; i<state_count; i++) {
     for(j=0;j<state_count; j++)
-      fprintf(f,"%d\t",optimistic_reach[i*state_count + j]);
-    fprintf(f,"\n"); }
+      w_printf(f,"%d\t",optimistic_reach[i*state_count + j]);
+    w_printf(f,"\n"); }
 
   {
     BState *s2;
@@ -1362,7 +2233,7 @@ static void print_behaviours(const Buchi *b, FILE *f,
     for (s2 = b->bstates->prv; s2 != b->bstates; s2 = s2->prv)
       if((s2->final == b->accept || s2 -> id == 0) && optimistic_reach[(s2->label)*(state_count+1)])
         add_set(accepting_cycles,s2->label);
-    fprintf(f,"\nAccepting optimistic cycles: ");
+    w_printf(f,"\nAccepting optimistic cycles: ");
     print_set(f, accepting_cycles,state_size);
 
     int * accepting_states=make_set(LTL2BA_EMPTY_SET,state_size);
@@ -1371,149 +2242,297 @@ static void print_behaviours(const Buchi *b, FILE *f,
         /* fprintf(tl_out,"\n*** r:%d c:%d reach:%d in_set:%d\n",r,c,reach[r*state_count+c],in_set(accepting_cycles,c)); */
         if(optimistic_reach[r*state_count+c] && in_set(accepting_cycles,c))
           add_set(accepting_states,r); }
-    fprintf(f,"\nAccepting optimistic states: ");
+    w_printf(f,"\nAccepting optimistic states: ");
     print_set(f, accepting_states,state_size);
-    fprintf(f,"\n");
+    w_printf(f,"\n");
     tfree(accepting_cycles);
 
     as->optimistic_accept_state_set = accepting_states;
   }
   tfree(optimistic_reach);
+  closure_work_free(&closure);
 
-  fprintf(f,"\n\nPessimistic transitions:\n");
+  w_printf(f,"\n\nPessimistic transitions:\n");
   for(i=0; i<state_count; i++) {
-    fprintf(f,"%2d: ",i);
+    w_printf(f,"%2d: ",i);
     set_list = pessimistic_transition[i];
     while (set_list != (Slist*)0) {
       print_set(f, set_list->set,state_size);
       set_list = set_list->nxt; }
-    fprintf(f,"\n"); }
+    w_printf(f,"\n"); }
 
-  int* pessimistic_reachable[state_count];
-  fprintf(f,"\n\nPessimistic reachable:\n");
+  int **pessimistic_reachable = pess_reach(pessimistic_transition, state_count, state_count, state_size);
+  w_printf(f,"\n\nPessimistic reachable:\n");
   for(i=0; i<state_count; i++) {
-    fprintf(f,"%2d: ",i);
-    pessimistic_reachable[i] = pess_reach(pessimistic_transition, i, state_count, state_count, state_size);
+    w_printf(f,"%2d: ",i);
     print_set(f, pessimistic_reachable[i],state_size);
-    fprintf(f,"\n"); }
+    w_printf(f,"\n"); }
 
   int *accepting_pessimistic_cycles=make_set(LTL2BA_EMPTY_SET,state_size);
   BState* s2;
   for (s2 = b->bstates->prv; s2 != b->bstates; s2 = s2->prv)
     if((s2->final == b->accept || s2 -> id == 0) && in_set(pessimistic_reachable[s2->label],s2->label))
       add_set(accepting_pessimistic_cycles,s2->label);
-  fprintf(f,"\nAccepting pessimistic cycles: ");
+  w_printf(f,"\nAccepting pessimistic cycles: ");
   print_set(f, accepting_pessimistic_cycles,state_size);
 
   int *accepting_pessimistic_states=make_set(LTL2BA_EMPTY_SET,state_size);
   for (s2 = b->bstates->prv; s2 != b->bstates; s2 = s2->prv)
     if(!empty_intersect_sets(pessimistic_reachable[s2->label],accepting_pessimistic_cycles,state_size))
       add_set(accepting_pessimistic_states,s2->label);
-  fprintf(f,"\nAccepting pessimistic states: ");
+  w_printf(f,"\nAccepting pessimistic states: ");
   print_set(f, accepting_pessimistic_states,state_size);
   as->pessimistic_accept_state_set = accepting_pessimistic_states;
-  fprintf(f,"\n");
+  w_printf(f,"\n");
+  return LTL2BA_OK;
 }
 
-static void print_c_accept_tables(FILE *f, const char *const *sym_table,
+/* prints the set of states l as the words of a uint64_t bitmap */
+static void print_c_bitmap(Writer *f, int *l, int g_num_states)
+{
+  int w, state;
+  unsigned long long bits;
+
+  w_printf(f, "{ ");
+  for (w = 0; w * 64 < g_num_states; w++) {
+    bits = 0;
+    for (state = w * 64; state < g_num_states && state < (w + 1) * 64; state++)
+      if (in_set(l, state))
+        bits |= 1ULL << (state - w * 64);
+    w_printf(f, "0x%llxULL, ", bits);
+  }
+  w_printf(f, "}");
+}
+
+/* tests if one of the transitions of g is enabled by the letter l */
+static int group_on_letter(const BIndex *x, const BGroup *g, unsigned l,
+                           int sym_id)
+{
+  BTrans *t;
+  int j;
+  for (j = g->first; j < g->first + g->count; j++) {
+    t = x->trans[j];
+    if ((!t->pos || (l & c_sym_mask(t->pos, sym_id)) == c_sym_mask(t->pos, sym_id)) &&
+        (!t->neg || !(l & c_sym_mask(t->neg, sym_id))))
+      return 1;
+  }
+  return 0;
+}
+
+/* Prints the states having an enabled transition under each letter. All
+ * the letters of a letter class enable the same transitions, and the
+ * classes leaving the same states viable share a row: the states viable
+ * under the letter l are the bits of %s_viable_rows[%s_step_row[l]]. */
+static void print_c_step_tables(Writer *f, const BIndex *x,
+                                const struct accept_sets *as, int sym_id,
+                                const char *prefix)
+{
+  const struct letter_classes *lc = &as->classes;
+  int n = x->nstates;
+  int num_words = (n + 63) / 64;
+  int state_size = LTL2BA_SET_SIZE(n);
+  int num_rows = 0, i, j, k, c;
+  int *row_of_class = (int *)tl_emalloc(lc->count * sizeof(int));
+  int **rows = (int **)tl_emalloc(lc->count * sizeof(int *));
+  unsigned *hash = (unsigned *)tl_emalloc(lc->count * sizeof(unsigned));
+  int hmask, *slot = new_slots(lc->count, &hmask);
+  int *viable = new_set(state_size);
+  const char *idx_type;
+  unsigned l, h;
+
+  for (c = 0; c < lc->count; c++) {
+    l = c_sym_mask(lc->rep[c], sym_id);
+    clear_set(viable, state_size);
+    for (i = 0; i < n; i++)
+      for (j = x->group_off[i]; j < x->group_off[i + 1]; j++)
+        if (group_on_letter(x, &x->groups[j], l, sym_id)) {
+          add_set(viable, i);
+          break;
+        }
+    h = hash_set(viable, state_size);
+    for (k = h & hmask; (j = slot[k]) >= 0; k = (k + 1) & hmask)
+      if (hash[j] == h && same_sets(rows[j], viable, state_size))
+        break;
+    if (j < 0) {
+      j = slot[k] = num_rows;
+      rows[num_rows] = dup_set(viable, state_size);
+      hash[num_rows++] = h;
+    }
+    row_of_class[c] = j;
+  }
+
+  idx_type = num_rows <= 256 ? "uint8_t" : num_rows <= 65536 ? "uint16_t" : "uint32_t";
+  w_printf(f, "static const %s %s_step_row[%d] = {",
+           idx_type, prefix, 1 << sym_id);
+  for (l = 0; l < 1U << sym_id; l++)
+    w_printf(f, "%s%d,", l % 16 ? " " : "\n  ",
+             row_of_class[class_of_letter(lc, l)]);
+  w_printf(f, "\n};\n\n");
+
+  w_printf(f, "static const uint64_t %s_viable_rows[%d][%d] = {\n",
+           prefix, num_rows, num_words);
+  for (j = 0; j < num_rows; j++) {
+    w_printf(f, "  ");
+    print_c_bitmap(f, rows[j], n);
+    w_printf(f, ",\n");
+  }
+  w_printf(f, "};\n\n");
+
+  w_printf(f, "_Bool\n%s_state_is_viable(unsigned int sym_idx, unsigned int state)\n{\n",
+           prefix);
+  w_printf(f, "\tconst uint64_t *row = %s_viable_rows[%s_step_row[sym_idx]];\n",
+           prefix, prefix);
+  w_printf(f, "\treturn (row[state / 64] >> (state %% 64)) & 1;\n}\n\n");
+
+  for (j = 0; j < num_rows; j++)
+    tfree(rows[j]);
+  tfree(row_of_class);
+  tfree(rows);
+  tfree(hash);
+  tfree(slot);
+  tfree(viable);
+}
+static void print_c_accept_tables(Writer *f, const Symbol *const *sym_table,
                                   int sym_id, int g_num_states,
                                   const struct accept_sets *as,
                                   const char *c_sym_name_prefix)
 {
-  int sym_comb, state, i;
-
+  int sym_comb, i, j;
   int num_sym_combs = 1 << sym_id;
-
-  /* Print static table of whether states accept, given an input symbol. */
-  fprintf(f, "_Bool %s_stutter_accept_table[%d][%d] = {\n",
-		  c_sym_name_prefix, num_sym_combs, g_num_states);
-  for (sym_comb = 0; sym_comb < num_sym_combs; sym_comb++) {
-    fprintf(f, "{\n  ");
-    for (state = 0; state < g_num_states; state++) {
-      if (in_set(as->stutter_accept_table[sym_comb], state))
-        fprintf(f, "true, ");
-      else
-        fprintf(f, "false, ");
+  int num_words = (g_num_states + 63) / 64;
+  int state_size = LTL2BA_SET_SIZE(g_num_states);
+  int num_rows = 0;
+  int *row_of_class = (int *)tl_emalloc(as->classes.count * sizeof(int));
+  int **rows = (int **)tl_emalloc(as->classes.count * sizeof(int *));
+  unsigned *hash = (unsigned *)tl_emalloc(as->classes.count * sizeof(unsigned));
+  int k, hmask, *slot = new_slots(as->classes.count, &hmask);
+  const char *idx_type;
+
+  /* The letter classes with the same accepting states share a row */
+  for (i = 0; i < as->classes.count; i++) {
+    int *accepting = as->stutter_accept_table[i];
+    unsigned h = hash_set(accepting, state_size);
+    for (k = h & hmask; (j = slot[k]) >= 0; k = (k + 1) & hmask)
+      if (hash[j] == h && same_sets(rows[j], accepting, state_size))
+        break;
+    if (j < 0) {
+      j = slot[k] = num_rows;
+      rows[num_rows] = accepting;
+      hash[num_rows++] = h;
     }
-    fprintf(f, "\n},\n");
+    row_of_class[i] = j;
   }
-  fprintf(f, "};\n\n");
 
-  fprintf(f, "_Bool %s_good_prefix_excluded_states[%d] = {\n",
-		  c_sym_name_prefix, g_num_states);
-  for (state = 0; state < g_num_states; state++) {
-    if (in_set(as->optimistic_accept_state_set, state))
-      fprintf(f, "true, ");
-    else
-      fprintf(f, "false, ");
+  /* Print static bitmaps of whether states accept, given an input symbol:
+   * the states of row i are the bits of %s_stutter_accept_rows[i], and
+   * %s_stutter_accept_row gives the row of each input symbol. */
+  w_printf(f, "static const uint64_t %s_stutter_accept_rows[%d][%d] = {\n",
+		  c_sym_name_prefix, num_rows, num_words);
+  for (j = 0; j < num_rows; j++) {
+    w_printf(f, "  ");
+    print_c_bitmap(f, rows[j], g_num_states);
+    w_printf(f, ",\n");
   }
-  fprintf(f, "\n};\n\n");
+  w_printf(f, "};\n\n");
+
+  idx_type = num_rows <= 256 ? "uint8_t" : num_rows <= 65536 ? "uint16_t" : "uint32_t";
+  w_printf(f, "static const %s %s_stutter_accept_row[%d] = {",
+		  idx_type, c_sym_name_prefix, num_sym_combs);
+  for (sym_comb = 0; sym_comb < num_sym_combs; sym_comb++)
+    w_printf(f, "%s%d,", sym_comb % 16 ? " " : "\n  ",
+            row_of_class[class_of_letter(&as->classes, sym_comb)]);
+  w_printf(f, "\n};\n\n");
+
+  w_printf(f, "static const uint64_t %s_good_prefix_excluded_states[%d] = ",
+		  c_sym_name_prefix, num_words);
+  print_c_bitmap(f, as->optimistic_accept_state_set, g_num_states);
+  w_printf(f, ";\n\n");
+
+  w_printf(f, "static const uint64_t %s_bad_prefix_states[%d] = ",
+		  c_sym_name_prefix, num_words);
+  print_c_bitmap(f, as->pessimistic_accept_state_set, g_num_states);
+  w_printf(f, ";\n\n");
+
+  w_printf(f, "_Bool\n%s_stutter_accepts(unsigned int sym_idx, unsigned int state)\n{\n",
+		  c_sym_name_prefix);
+  w_printf(f, "\tconst uint64_t *row = %s_stutter_accept_rows[%s_stutter_accept_row[sym_idx]];\n",
+		  c_sym_name_prefix, c_sym_name_prefix);
+  w_printf(f, "\treturn (row[state / 64] >> (state %% 64)) & 1;\n}\n\n");
 
-  fprintf(f, "_Bool %s_bad_prefix_states[%d] = {\n",
-		  c_sym_name_prefix, g_num_states);
-  for (state = 0; state < g_num_states; state++) {
-    if (in_set(as->pessimistic_accept_state_set, state))
-      fprintf(f, "true, ");
-    else
-      fprintf(f, "false, ");
-  }
-  fprintf(f, "\n};\n\n");
+  w_printf(f, "_Bool\n%s_good_prefix_excluded(unsigned int state)\n{\n",
+		  c_sym_name_prefix);
+  w_printf(f, "\treturn (%s_good_prefix_excluded_states[state / 64] >> (state %% 64)) & 1;\n}\n\n",
+		  c_sym_name_prefix);
+
+  w_printf(f, "_Bool\n%s_bad_prefix(unsigned int state)\n{\n",
+		  c_sym_name_prefix);
+  w_printf(f, "\treturn (%s_bad_prefix_states[state / 64] >> (state %% 64)) & 1;\n}\n\n",
+		  c_sym_name_prefix);
 
-  fprintf(f, "unsigned int\n%s_sym_to_idx(void)\n{\n", c_sym_name_prefix);
-  fprintf(f, "\tunsigned int idx = 0;\n");
+  w_printf(f, "unsigned int\n%s_sym_to_idx(void)\n{\n", c_sym_name_prefix);
+  w_printf(f, "\tunsigned int idx = 0;\n");
   for (i = 0; i < sym_id; i++) {
-    fprintf(f, "\tidx |= (%s()) ? 1 << %d : 0;\n", sym_table[i], i);
+    w_printf(f, "\tidx |= (%s()) ? 1 << %d : 0;\n", sym_table[i]->name, i);
   }
-  fprintf(f, "\treturn idx;\n}\n\n");
+  w_printf(f, "\treturn idx;\n}\n\n");
+
+  tfree(row_of_class);
+  tfree(rows);
+  tfree(hash);
+  tfree(slot);
 }
 
-static void print_c_epilog(FILE *f, const char *c_sym_name_prefix)
+static void print_c_epilog(Writer *f, const char *c_sym_name_prefix)
 {
-  fprintf(f, "void\nltl2ba_finish_monitor(pthread_t t)\n{\n");
-  fprintf(f, "\n\t__ESBMC_kill_monitor();\n\n");
+  w_printf(f, "void\nltl2ba_finish_monitor(pthread_t t)\n{\n");
+  w_printf(f, "\n\t__ESBMC_kill_monitor();\n\n");
 
   /* Assert we're not in a bad trap. */
-  fprintf(f, "\t__ESBMC_assert(!%s_bad_prefix_states[%s_statevar],"
-		  "\"LTL_BAD\");\n\n", c_sym_name_prefix, c_sym_name_prefix,
-		  c_sym_name_prefix);
+  w_printf(f, "\t__ESBMC_assert(!%s_bad_prefix(%s_statevar),"
+		  "\"LTL_BAD\");\n\n", c_sym_name_prefix, c_sym_name_prefix);
 
   /* Assert whether we're in a failing state */
-  fprintf(f, "\t__ESBMC_assert(!%s_stutter_accept_table[%s_sym_to_idx()][%s_statevar],"
+  w_printf(f, "\t__ESBMC_assert(!%s_stutter_accepts(%s_sym_to_idx(), %s_statevar),"
 		  "\"LTL_FAILING\");\n\n", c_sym_name_prefix, c_sym_name_prefix,
 		  c_sym_name_prefix);
 
   /* Assert whether we're in a succeeding state */
-  fprintf(f, "\t__ESBMC_assert(!%s_good_prefix_excluded_states[%s_statevar],"
-		  "\"LTL_SUCCEEDING\");\n\n", c_sym_name_prefix, c_sym_name_prefix,
-		  c_sym_name_prefix);
+  w_printf(f, "\t__ESBMC_assert(!%s_good_prefix_excluded(%s_statevar),"
+		  "\"LTL_SUCCEEDING\");\n\n", c_sym_name_prefix, c_sym_name_prefix);
 
-  fprintf(f, "\treturn;\n}\n");
+  w_printf(f, "\treturn;\n}\n");
 }
 
-void print_c_buchi(FILE *f, const Buchi *b, const char *const *sym_table,
-                   const Cexprtab *cexpr, int sym_id,
-                   const char *c_sym_name_prefix, const char *extern_header,
-                   const char *cmdline)
+static Status print_c_monitor(Writer *f, const Buchi *b,
+                              const Symbol *const *sym_table,
+                              const Cexprtab *cexpr, int sym_id,
+                              const char *c_sym_name_prefix,
+                              const char *extern_header, const char *cmdline,
+                              int tables)
 {
-  BTrans *t, *t1;
-  BState *s;
   struct accept_sets as;
-  int i, num_states;
+  BIndex x;
+  int num_states, g_num_states;
+  Status status;
 
   if (b->bstates->nxt == b->bstates) {
-    fprintf(f, "#error Empty Buchi automaton\n");
-    return;
+    w_printf(f, "#error Empty Buchi automaton\n");
+    return LTL2BA_OK;
   } else if (b->bstates->nxt->nxt == b->bstates && b->bstates->nxt->id == 0) {
-    fprintf(f, "#error Always-true Buchi automaton\n");
-    return;
+    w_printf(f, "#error Always-true Buchi automaton\n");
+    return LTL2BA_OK;
   }
 
-  fprintf(f, "#if 0\n");
+  w_printf(f, "#if 0\n");
   if (cmdline)
-    fprintf(f, "generated by libltl2ba with command: %s\n", cmdline);
-  fprintf(f, "/* Precomputed transition data */\n");
-  print_behaviours(b, f, sym_table, cexpr, sym_id, &as);
-  fprintf(f, "#endif\n");
+    w_printf(f, "generated by libltl2ba with command: %s\n", cmdline);
+  w_printf(f, "/* Precomputed transition data */\n");
+  make_bindex(b, 1, &x);
+  if ((status = print_behaviours(b, &x, f, sym_table, cexpr, sym_id, &as))) {
+    free_bindex(&x);
+    return status;
+  }
+  w_printf(f, "#endif\n");
 
   print_c_headers(f, cexpr, c_sym_name_prefix, extern_header);
 
@@ -1523,9 +2542,14 @@ void print_c_buchi(FILE *f, const Buchi *b, const char *const *sym_table,
 
   /* And now produce state machine */
 
-  print_fsm_func_opener(f);
-
-  int g_num_states = print_c_buchi_body(f, b, sym_table, c_sym_name_prefix);
+  if (tables) {
+    print_c_step_tables(f, &x, &as, sym_id, c_sym_name_prefix);
+    g_num_states = print_c_table_body(f, &x, sym_id, c_sym_name_prefix);
+  } else {
+    print_fsm_func_opener(f);
+    g_num_states = print_c_buchi_body(f, b, &x, sym_table, sym_id,
+                                      c_sym_name_prefix);
+  }
 
   print_c_buchi_body_tail(f);
 
@@ -1535,4 +2559,26 @@ void print_c_buchi(FILE *f, const Buchi *b, const char *const *sym_table,
   print_c_accept_tables(f, sym_table, sym_id, g_num_states, &as, c_sym_name_prefix);
 
   print_c_epilog(f, c_sym_name_prefix);
+
+  free_bindex(&x);
+  return LTL2BA_OK;
+}
+
+Status print_c_buchi(Writer *f, const Buchi *b, const Symbol *const *sym_table,
+                     const Cexprtab *cexpr, int sym_id,
+                     const char *c_sym_name_prefix, const char *extern_header,
+                     const char *cmdline)
+{
+  return print_c_monitor(f, b, sym_table, cexpr, sym_id, c_sym_name_prefix,
+                         extern_header, cmdline, 0);
+}
+
+Status print_c_table_buchi(Writer *f, const Buchi *b,
+                           const Symbol *const *sym_table,
+                           const Cexprtab *cexpr, int sym_id,
+                           const char *c_sym_name_prefix,
+                           const char *extern_header, const char *cmdline)
+{
+  return print_c_monitor(f, b, sym_table, cexpr, sym_id, c_sym_name_prefix,
+                         extern_header, cmdline, 1);
 }
@@ -22,7 +22,7 @@ static Cache	*stored = (Cache *) 0;
 static unsigned long	Caches, CacheHits;
 
 static int ismatch(const Node *, const Node *);
-static int sameform(const Node *, const Node *);
+static int sameform(const Node *, int, const Node *, int);
 
 void cache_dump(void)
 {
@@ -79,24 +79,39 @@ Node * cached(Symtab symtab, Node *n)
 }
 
 void
-cache_stats(void)
+cache_stats(Stats *stats)
 {
-	fprintf(stderr, "cache stores     : %9ld\n", Caches);
-	fprintf(stderr, "cache hits       : %9ld\n", CacheHits);
+	stats->cache_stores = Caches;
+	stats->cache_hits   = CacheHits;
 }
 
 void
 releasenode(int all_levels, Node *n)
 {
+	Node *local[64], **st = local, *m;
+	int sp = 0, size = 64;
+
 	if (!n) return;
 
-	if (all_levels)
-	{	releasenode(1, n->lft);
-		n->lft = NULL;
-		releasenode(1, n->rgt);
-		n->rgt = NULL;
+	if (!all_levels)
+	{	tfree((void *) n);
+		return;
+	}
+	st[sp++] = n;
+	while (sp)	/* the left operand, the right one, then the node */
+	{	n = st[sp - 1];
+		if ((m = n->lft) || (m = n->rgt))
+		{	if (m == n->lft)
+				n->lft = NULL;
+			else
+				n->rgt = NULL;
+			STACK_PUSH(st, sp, size, local, m);
+			continue;
+		}
+		tfree((void *) n);
+		sp--;
 	}
-	tfree((void *) n);
+	STACK_FREE(st, local);
 }
 
 Node *
@@ -129,145 +144,276 @@ static Node * getnode(const Node *p)
 
 Node * dupnode(const Node *n)
 {
-	Node *d;
+	struct { const Node *from; Node **to; } local[64], *st = local, x;
+	int sp = 0, size = 64;
+	Node *d = NULL;
 
 	if (!n)
 		return NULL;
-	d = getnode(n);
-	d->lft = dupnode(n->lft);
-	d->rgt = dupnode(n->rgt);
+	st[sp].from = n;
+	st[sp++].to = &d;
+	while (sp)	/* in preorder, the left operands first */
+	{	x = st[--sp];
+		*x.to = getnode(x.from);
+		if (x.from->rgt)
+		{	STACK_RESERVE(st, sp, size, local);
+			st[sp].from = x.from->rgt;
+			st[sp++].to = &(*x.to)->rgt;
+		}
+		if (x.from->lft)
+		{	STACK_RESERVE(st, sp, size, local);
+			st[sp].from = x.from->lft;
+			st[sp++].to = &(*x.to)->lft;
+		}
+	}
+	STACK_FREE(st, local);
 	return d;
 }
 
-int one_lft(int ntyp, const Node *x, const Node *in)
+/* the symbol of a signed node: a negated predicate is a NOT */
+static const Symbol *sgn_sym(const Node *n, int neg)
 {
-	if (!x)  return 1;
-	if (!in) return 0;
-
-	if (sameform(x, in))
-		return 1;
-
-	if (in->ntyp != ntyp)
-		return 0;
-
-	if (one_lft(ntyp, x, in->lft))
-		return 1;
-
-	return one_lft(ntyp, x, in->rgt);
+	return (neg && n->ntyp == PREDICATE) ? NULL : n->sym;
 }
 
-int all_lfts(int ntyp, const Node *from, const Node *in)
-{
-	if (!from) return 1;
-
-	if (from->ntyp != ntyp)
-		return one_lft(ntyp, from, in);
-
-	if (!one_lft(ntyp, from->lft, in))
-		return 0;
-
-	return all_lfts(ntyp, from->rgt, in);
+/* The calls of sameform() and of the helpers it had, all_lfts() and
+ * one_lft(), run on an explicit stack: a call waiting for a result is
+ * resumed at pc, and the calls that ended them (going down the operand
+ * chains) replace the caller instead of being stacked. */
+enum { SAME_FORM, ALL_LFTS, ONE_LFT };
+
+typedef struct {
+	const Node *a, *b; /* all_lfts(from, in), one_lft(x, in) */
+	int na, nb;
+	int ntyp;          /* the type of the trees of all_lfts(), one_lft() */
+	char call, pc;
+} SameCall;
+
+static void
+same_push(SameCall **st, int *sp, int *size, SameCall *local, int call,
+	  const Node *a, int na, const Node *b, int nb, int ntyp)
+{	SameCall *c;
+
+	STACK_RESERVE(*st, *sp, *size, local);
+	c = &(*st)[(*sp)++];
+	c->a = a;
+	c->na = na;
+	c->b = b;
+	c->nb = nb;
+	c->ntyp = ntyp;
+	c->call = call;
+	c->pc = 0;
 }
 
-int sametrees(int ntyp, const Node *a, const Node *b)
-{	/* toplevel is an AND or OR */
-	/* both trees are right-linked, but the leafs */
-	/* can be in different places in the two trees */
-
-	if (!all_lfts(ntyp, a, b))
-		return 0;
-
-	return all_lfts(ntyp, b, a);
-}
-
-/* a better isequal() */
-static int sameform(const Node *a, const Node *b)
+/* a better isequal(): the operands of AND and OR are compared as sets */
+static int sameform(const Node *a, int na, const Node *b, int nb)
 {
-	if (!a && !b) return 1;
-	if (!a || !b) return 0;
-	if (a->ntyp != b->ntyp) return 0;
-
-	if (a->sym
-	&&  b->sym
-	&&  strcmp(a->sym->name, b->sym->name) != 0)
-		return 0;
-
-	switch (a->ntyp) {
-	case TRUE:
-	case FALSE:
-		return 1;
-	case PREDICATE:
-		if (!a->sym || !b->sym) fatal("sameform...");
-		return !strcmp(a->sym->name, b->sym->name);
-
-	case NOT:
-	case NEXT:
-		return sameform(a->lft, b->lft);
-
-	case U_OPER:
-	case V_OPER:
-		if (!sameform(a->lft, b->lft))
-			return 0;
-		if (!sameform(a->rgt, b->rgt))
-			return 0;
-		return 1;
-
-	case AND:
-	case OR:	/* the hard case */
-		return sametrees(a->ntyp, a, b);
-
-	default:
-		fprintf(stderr, "type: %d\n", a->ntyp);
-		fatal("cannot happen, sameform");
+	SameCall local[32], *st = local, *c;
+	int sp = 0, size = 32, r = 0, t;
+	const Symbol *sa, *sb;
+
+#define Return(v)	{ r = (v); sp--; continue; }
+	same_push(&st, &sp, &size, local, SAME_FORM, a, na, b, nb, 0);
+	while (sp)
+	{	c = &st[sp - 1];
+		switch (c->call) {
+		case SAME_FORM:
+			if (c->pc == 1)	/* U, V: the left operands are the same */
+			{	if (!r) Return(0);
+				c->a = c->a->rgt;
+				c->b = c->b->rgt;
+				c->pc = 0;
+				continue;
+			}
+			if (c->pc == 2)	/* AND, OR: those of a are in b */
+			{	if (!r) Return(0);
+				c->call = ALL_LFTS;
+				a = c->a, c->a = c->b, c->b = a;
+				t = c->na, c->na = c->nb, c->nb = t;
+				c->pc = 0;
+				continue;
+			}
+			sgn_norm(&c->a, &c->na);
+			sgn_norm(&c->b, &c->nb);
+			if (!c->a || !c->b) Return(!c->a && !c->b);
+			t = sgn_ntyp(c->a, c->na);
+			if (t != sgn_ntyp(c->b, c->nb)) Return(0);
+
+			sa = sgn_sym(c->a, c->na);
+			sb = sgn_sym(c->b, c->nb);
+			if (sa
+			&&  sb
+			&&  strcmp(sa->name, sb->name) != 0)
+				Return(0);
+
+			switch (t) {
+			case TRUE:
+			case FALSE:
+				Return(1);
+			case PREDICATE:
+				if (!sa || !sb) fatal("sameform...");
+				Return(!strcmp(sa->name, sb->name));
+
+			case NOT:
+			case NEXT:
+				c->a = sgn_lft(c->a, &c->na);
+				c->b = sgn_lft(c->b, &c->nb);
+				continue;
+
+			case U_OPER:
+			case V_OPER:
+				c->pc = 1;
+				same_push(&st, &sp, &size, local, SAME_FORM,
+					  c->a->lft, c->na, c->b->lft, c->nb, 0);
+				continue;
+
+			case AND:
+			case OR:	/* the hard case */
+				c->pc = 2;
+				c->ntyp = t;
+				same_push(&st, &sp, &size, local, ALL_LFTS,
+					  c->a, c->na, c->b, c->nb, t);
+				continue;
+
+			default:
+				fprintf(stderr, "type: %d\n", t);
+				fatal("cannot happen, sameform");
+			}
+			break;
+
+		case ALL_LFTS:	/* each operand of from is somewhere in in */
+			if (c->pc == 1)
+			{	if (!r) Return(0);
+				c->a = c->a->rgt;
+				c->pc = 0;
+				continue;
+			}
+			sgn_norm(&c->a, &c->na);
+			if (!c->a) Return(1);
+			if (sgn_ntyp(c->a, c->na) != c->ntyp)
+			{	c->call = ONE_LFT;
+				continue;
+			}
+			c->pc = 1;
+			same_push(&st, &sp, &size, local, ONE_LFT,
+				  c->a->lft, c->na, c->b, c->nb, c->ntyp);
+			continue;
+
+		case ONE_LFT:	/* x is in the operands of in */
+			if (c->pc == 1)
+			{	if (r) Return(1);
+				if (sgn_ntyp(c->b, c->nb) != c->ntyp) Return(0);
+				c->pc = 2;
+				same_push(&st, &sp, &size, local, ONE_LFT,
+					  c->a, c->na, c->b->lft, c->nb, c->ntyp);
+				continue;
+			}
+			if (c->pc == 2)
+			{	if (r) Return(1);
+				c->b = c->b->rgt;
+				c->pc = 0;
+				continue;
+			}
+			sgn_norm(&c->a, &c->na);
+			sgn_norm(&c->b, &c->nb);
+			if (!c->a) Return(1);
+			if (!c->b) Return(0);
+			c->pc = 1;
+			same_push(&st, &sp, &size, local, SAME_FORM,
+				  c->a, c->na, c->b, c->nb, 0);
+			continue;
+		}
 	}
-
-	return 0;
+#undef Return
+	STACK_FREE(st, local);
+	return r;
 }
 
-int isequal(const Node *a, const Node *b)
+/* isequal() on signed nodes: na and nb negate a and b. The nodes match one
+ * for one, a missing operand matching true, and where the operands of two
+ * matching nodes do not, the nodes are compared by sameform(). The nodes
+ * waiting for the comparison of their operands are kept on an explicit
+ * stack. */
+int isequal_sgn(const Node *a, int na, const Node *b, int nb)
 {
-	if (!a && !b)
-		return 1;
-
-	if (!a || !b)
-	{	if (!a)
-		{	if (b->ntyp == TRUE)
-				return 1;
-		} else
-		{	if (a->ntyp == TRUE)
-				return 1;
+	struct { const Node *a, *b; int na, nb, pc; } local[64], *st = local;
+	const Symbol *sa, *sb;
+	int sp = 0, size = 64, r;
+
+	for (;;)
+	{	/* compares a and b */
+		sgn_norm(&a, &na);
+		sgn_norm(&b, &nb);
+		if (!a || !b)
+			r = (!a && !b)
+			 || (a ? sgn_ntyp(a, na) : sgn_ntyp(b, nb)) == TRUE;
+		else if (sgn_ntyp(a, na) != sgn_ntyp(b, nb))
+			r = 0;
+		else if ((sa = sgn_sym(a, na))
+		     &&  (sb = sgn_sym(b, nb))
+		     &&  strcmp(sa->name, sb->name) != 0)
+			r = 0;
+		else
+		{	STACK_RESERVE(st, sp, size, local);
+			st[sp].a = a, st[sp].na = na;
+			st[sp].b = b, st[sp].nb = nb;
+			st[sp++].pc = 0;	/* the left operands first */
+			a = sgn_lft(a, &na);
+			b = sgn_lft(b, &nb);
+			continue;
 		}
-		return 0;
-	}
-	if (a->ntyp != b->ntyp)
-		return 0;
-
-	if (a->sym
-	&&  b->sym
-	&&  strcmp(a->sym->name, b->sym->name) != 0)
-		return 0;
 
-	if (isequal(a->lft, b->lft)
-	&&  isequal(a->rgt, b->rgt))
-		return 1;
+		/* r is the result for the operands st[sp - 1].pc */
+		for (; sp; sp--)
+		{	if (r && !st[sp - 1].pc)
+				break;
+			if (!r)
+				r = sameform(st[sp - 1].a, st[sp - 1].na,
+					     st[sp - 1].b, st[sp - 1].nb);
+		}
+		if (!sp)
+			break;
+		st[sp - 1].pc = 1;	/* then the right ones */
+		a = st[sp - 1].a->rgt, na = st[sp - 1].na;
+		b = st[sp - 1].b->rgt, nb = st[sp - 1].nb;
+	}
+	STACK_FREE(st, local);
+	return r;
+}
 
-	return sameform(a, b);
+int isequal(const Node *a, const Node *b)
+{
+	return isequal_sgn(a, 0, b, 0);
 }
 
+/* the same trees, node for node */
 static int ismatch(const Node *a, const Node *b)
 {
-	if (!a && !b) return 1;
-	if (!a || !b) return 0;
-	if (a->ntyp != b->ntyp) return 0;
-
-	if (a->sym
-	&&  b->sym
-	&&  strcmp(a->sym->name, b->sym->name) != 0)
-		return 0;
-
-	if (ismatch(a->lft, b->lft)
-	&&  ismatch(a->rgt, b->rgt))
-		return 1;
-
-	return 0;
+	struct { const Node *a, *b; } local[64], *st = local;
+	int sp = 0, size = 64, r = 1;
+
+	st[sp].a = a;
+	st[sp++].b = b;
+	while (r && sp)
+	{	sp--;
+		a = st[sp].a;
+		b = st[sp].b;
+		if (!a && !b) continue;
+		if (!a || !b
+		||  a->ntyp != b->ntyp
+		|| (a->sym
+		&&  b->sym
+		&&  strcmp(a->sym->name, b->sym->name) != 0))
+		{	r = 0;
+			continue;
+		}
+		STACK_RESERVE(st, sp, size, local);
+		st[sp].a = a->rgt;
+		st[sp++].b = b->rgt;
+		STACK_RESERVE(st, sp, size, local);
+		st[sp].a = a->lft;
+		st[sp++].b = b->lft;
+	}
+	STACK_FREE(st, local);
+	return r;
 }
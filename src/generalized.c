@@ -8,36 +8,57 @@
 
 #include "internal.h"
 
-#undef min
-#define min(x,y)        ((x<y)?x:y)
-
 /********************************************************************\
-|*              Structures and shared variables                     *|
+|*        Simplification of the generalized Buchi automaton         *|
 \********************************************************************/
 
-struct gcounts {
-  int gstate_count, gtrans_count;
-};
+/* adds t, a transition from s, to the list of the transitions to t->to */
+static void link_gtrans(GState *s, GTrans *t)
+{
+  t->from = s;
+  t->in_prv = (GTrans *)0;
+  t->in_nxt = t->to->in;
+  if(t->in_nxt) t->in_nxt->in_prv = t;
+  t->to->in = t;
+}
 
-typedef struct GScc {
-  GState *gstate;
-  int rank;
-  int theta;
-  struct GScc *nxt;
-} GScc;
+/* removes t from the list of the transitions to t->to */
+static void unlink_gtrans(GTrans *t)
+{
+  if(t->in_prv) t->in_prv->in_nxt = t->in_nxt;
+  else t->to->in = t->in_nxt;
+  if(t->in_nxt) t->in_nxt->in_prv = t->in_prv;
+}
 
-struct gdfs_state {
-  int rank;
-  int scc_id;
-  GScc *scc_stack;
-};
+static void unlink_all_gtrans(GState *s)
+{
+  GTrans *t;
+  for(t = s->trans->nxt; t != s->trans; t = t->nxt)
+    unlink_gtrans(t);
+}
 
-/********************************************************************\
-|*        Simplification of the generalized Buchi automaton         *|
-\********************************************************************/
+/* removes the transition t from s, by moving the next one into t */
+static void delete_gtrans(const set_sizes *sz, GState *s, GTrans *t)
+{
+  GTrans *free = t->nxt;
+  unlink_gtrans(t);
+  t->to = free->to;
+  copy_set(free->pos, t->pos, sz->sym_size);
+  copy_set(free->neg, t->neg, sz->sym_size);
+  copy_set(free->final, t->final, sz->node_size);
+  t->nxt = free->nxt;
+  if(free == s->trans)
+    s->trans = t; /* t is the new sentinel */
+  else {
+    unlink_gtrans(free);
+    link_gtrans(s, t);
+  }
+  free_gtrans(free, 0, 0);
+}
 
 static void free_gstate(GState *s) /* frees a state and its transitions */
 {
+  unlink_all_gtrans(s);
   free_gtrans(s->trans->nxt, s->trans, 1);
   tfree(s->nodes_set);
   tfree(s);
@@ -49,19 +70,32 @@ static GState *remove_gstate(GState *s, GState *s1, GState *gremoved)
   GState *prv = s->prv;
   s->prv->nxt = s->nxt;
   s->nxt->prv = s->prv;
+  unlink_all_gtrans(s);
   free_gtrans(s->trans->nxt, s->trans, 0);
   s->trans = (GTrans *)0;
   tfree(s->nodes_set);
   s->nodes_set = 0;
   s->nxt = gremoved->nxt;
   gremoved->nxt = s;
-  s->prv = s1;
-  for(s1 = gremoved->nxt; s1 != gremoved; s1 = s1->nxt)
-    if(s1->prv == s)
-      s1->prv = s->prv;
+  s->prv = s1; /* s is now represented by s1, see gstate_rep() */
   return prv;
 }
 
+/* returns the state that replaces the removed state s (or s itself if it is
+ * not removed), or 0 if s was removed without replacement; 'prv' links the
+ * removed states to their replacement as a union-find with path compression */
+GState *gstate_rep(GState *s)
+{
+  GState *r, *nxt;
+  for(r = s; r && !r->trans; r = r->prv)
+    ;
+  for(; s != r; s = nxt) {
+    nxt = s->prv;
+    s->prv = r;
+  }
+  return r;
+}
+
 /* copies a transition */
 static void copy_gtrans(const set_sizes *sz, GTrans *from, GTrans *to)
 {
@@ -99,18 +133,56 @@ static int same_gtrans(const set_sizes *sz, GState *a, GTrans *s,
   return 1; /* same transitions up to acceptance conditions */
 }
 
+/* counts the states and the transitions */
+static void count_gstates(const Generalized *g, int *states, int *trans)
+{
+  GState *s;
+  GTrans *t;
+
+  *states = *trans = 0;
+  for(s = g->gstates->nxt; s != g->gstates; s = s->nxt) {
+    (*states)++;
+    for(t = s->trans->nxt; t != s->trans; t = t->nxt)
+      (*trans)++;
+  }
+}
+
+/* starts the measure of a simplification pass, if st is not NULL */
+static Pass *gpass_start(const Generalized *g, Stage *st, ltl2ba_PassKind kind,
+                         StatsClock *c)
+{
+  Pass *p;
+
+  if(!st)
+    return NULL;
+  p = stats_pass(st, kind);
+  count_gstates(g, &p->states_before, &p->trans_before);
+  stats_start(c);
+  return p;
+}
+
+static void gpass_stop(const Generalized *g, Pass *p, const StatsClock *c)
+{
+  if(!p)
+    return;
+  stats_stop(c, &p->time);
+  count_gstates(g, &p->states_after, &p->trans_after);
+}
+
 /* simplifies the transitions */
-static int simplify_gtrans(Generalized *g, FILE *f, Flags flags, int *bad_scc)
+static int simplify_gtrans(Generalized *g, Flags flags, int *bad_scc,
+                           Stage *st)
 {
   int changed = 0;
   GState *s;
   GTrans *t, *t1;
-  struct rusage tr_debut, tr_fin;
-  struct timeval t_diff;
-
-  if(flags & LTL2BA_STATS) getrusage(RUSAGE_SELF, &tr_debut);
+  StatsClock c;
+  Pass *p = gpass_start(g, st, LTL2BA_PASS_GTRANS, &c);
 
   for(s = g->gstates->nxt; s != g->gstates; s = s->nxt) {
+    if(!(s->dirty & DIRTY_TRANS))
+      continue; /* neither its transitions nor its scc changed since last time */
+    s->dirty &= ~DIRTY_TRANS;
     t = s->trans->nxt;
     while(t != s->trans) { /* tries to remove t */
       copy_gtrans(&g->sz, t, s->trans);
@@ -123,14 +195,8 @@ static int simplify_gtrans(Generalized *g, FILE *f, Flags flags, int *bad_scc)
               || ((flags & LTL2BA_SIMP_SCC) && ((s->incoming != t->to->incoming) || in_set(bad_scc, s->incoming))))) )
         t1 = t1->nxt;
       if(t1 != s->trans) { /* remove transition t */
-        GTrans *free = t->nxt;
-        t->to = free->to;
-        copy_set(free->pos, t->pos, g->sz.sym_size);
-        copy_set(free->neg, t->neg, g->sz.sym_size);
-        copy_set(free->final, t->final, g->sz.node_size);
-        t->nxt = free->nxt;
-        if(free == s->trans) s->trans = t;
-        free_gtrans(free, 0, 0);
+        delete_gtrans(&g->sz, s, t);
+        s->dirty |= DIRTY_STATES;
         changed++;
       }
       else
@@ -138,14 +204,7 @@ static int simplify_gtrans(Generalized *g, FILE *f, Flags flags, int *bad_scc)
     }
   }
 
-  if(flags & LTL2BA_STATS) {
-    getrusage(RUSAGE_SELF, &tr_fin);
-    timeval_subtract (&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
-    fprintf(f, "\nSimplification of the generalized Buchi automaton - transitions: %ld.%06lis",
-		t_diff.tv_sec, t_diff.tv_usec);
-    fprintf(f, "\n%i transitions removed\n", changed);
-  }
-
+  gpass_stop(g, p, &c);
   return changed;
 }
 
@@ -156,27 +215,21 @@ static void retarget_all_gtrans(Generalized *g, GState *gremoved)
   GTrans *t;
   int i;
   for (i = 0; i < g->init_size; i++)
-    if (g->init[i] && !g->init[i]->trans) /* init[i] has been removed */
-      g->init[i] = g->init[i]->prv;
-  for (s = g->gstates->nxt; s != g->gstates; s = s->nxt)
-    for (t = s->trans->nxt; t != s->trans; )
-      if (!t->to->trans) { /* t->to has been removed */
-	t->to = t->to->prv;
-	if(!t->to) { /* t->to has no transitions */
-	  GTrans *free = t->nxt;
-	  t->to = free->to;
-	  copy_set(free->pos, t->pos, g->sz.sym_size);
-	  copy_set(free->neg, t->neg, g->sz.sym_size);
-	  copy_set(free->final, t->final, g->sz.node_size);
-	  t->nxt   = free->nxt;
-	  if(free == s->trans) s->trans = t;
-	  free_gtrans(free, 0, 0);
-	}
-	else
-	  t = t->nxt;
+    if (g->init[i]) /* init[i] may have been removed */
+      g->init[i] = gstate_rep(g->init[i]);
+  for (s = gremoved->nxt; s != gremoved; s = s->nxt) {
+    GState *rep = gstate_rep(s);
+    while((t = s->in)) { /* t is a transition to the removed state s */
+      t->from->dirty |= DIRTY_TRANS | DIRTY_STATES;
+      if(!rep) /* s had no transitions */
+        delete_gtrans(&g->sz, t->from, t);
+      else {
+        unlink_gtrans(t);
+        t->to = rep;
+        link_gtrans(t->from, t);
       }
-      else
-	t = t->nxt;
+    }
+  }
   while(gremoved->nxt != gremoved) { /* clean the 'removed' list */
     s = gremoved->nxt;
     gremoved->nxt = gremoved->nxt->nxt;
@@ -208,105 +261,151 @@ static int all_gtrans_match(const Generalized *g, GState *a, GState *b,
 }
 
 /* eliminates redundant states */
-static int simplify_gstates(Generalized *g, FILE *f, Flags flags, int *bad_scc,
-                            GState *gremoved)
+static int simplify_gstates(Generalized *g, Flags flags, int *bad_scc,
+                            GState *gremoved, Stage *st)
 {
-  int changed = 0;
-  GState *a, *b;
-  struct rusage tr_debut, tr_fin;
-  struct timeval t_diff;
-
-  if(flags & LTL2BA_STATS) getrusage(RUSAGE_SELF, &tr_debut);
+  int changed = 0, nwl = 0, i, k = 0, use_scc = (flags & LTL2BA_SIMP_SCC) != 0;
+  GState *a, *b, **wl;
+  StatsClock c;
+  Pass *p = gpass_start(g, st, LTL2BA_PASS_GSTATES, &c);
+
+  /* Two states that did not change since the previous pass have already
+   * been compared and did not match: only the pairs involving a state of
+   * the worklist 'wl' (in the order of the list of states) are tried. */
+  for(a = g->gstates->nxt; a != g->gstates; a = a->nxt)
+    nwl++;
+  wl = (GState **)tl_emalloc((nwl + 1) * sizeof(GState *));
+  nwl = 0;
+  for(a = g->gstates->nxt; a != g->gstates; a = a->nxt)
+    if(a->dirty & DIRTY_STATES) {
+      a->dirty = (a->dirty & ~DIRTY_STATES) | DIRTY_SCAN;
+      wl[nwl++] = a;
+    }
 
   for(a = g->gstates->nxt; a != g->gstates; a = a->nxt) {
+    while(k < nwl && (wl[k] == a || !wl[k]->trans))
+      k++; /* wl[k..] are now the states of the worklist after a */
     if(a->trans == a->trans->nxt) { /* a has no transitions */
       a = remove_gstate(a, (GState *)0, gremoved);
       changed++;
       continue;
     }
-    g->gstates->trans = a->trans;
-    b = a->nxt;
-    while(!all_gtrans_match(g, a, b, (flags & LTL2BA_SIMP_SCC) != 0, bad_scc)) b = b->nxt;
+    if(a->dirty & DIRTY_SCAN) { /* compares a with all the states after it */
+      g->gstates->trans = a->trans;
+      b = a->nxt;
+      while(!all_gtrans_match(g, a, b, use_scc, bad_scc)) b = b->nxt;
+    }
+    else { /* compares a with the states of the worklist after it */
+      for(i = k; i < nwl; i++)
+        if(wl[i]->trans && all_gtrans_match(g, a, wl[i], use_scc, bad_scc))
+          break;
+      b = (i < nwl) ? wl[i] : g->gstates;
+    }
     if(b != g->gstates) { /* a and b are equivalent */
       /* if scc(a)>scc(b) and scc(a) is non-trivial then all_gtrans_match(a,b,use_scc) must fail */
       if(a->incoming > b->incoming) /* scc(a) is trivial */
         a = remove_gstate(a, b, gremoved);
-      else /* either scc(a)=scc(b) or scc(b) is trivial */
+      else { /* either scc(a)=scc(b) or scc(b) is trivial */
         remove_gstate(b, a, gremoved);
+        a->dirty |= DIRTY_STATES; /* the states after b were not compared with a */
+      }
       changed++;
     }
   }
+  for(a = g->gstates->nxt; a != g->gstates; a = a->nxt)
+    a->dirty &= ~DIRTY_SCAN;
+  tfree(wl);
   retarget_all_gtrans(g, gremoved);
 
-  if(flags & LTL2BA_STATS) {
-    getrusage(RUSAGE_SELF, &tr_fin);
-    timeval_subtract (&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
-    fprintf(f, "\nSimplification of the generalized Buchi automaton - states: %ld.%06lis",
-		t_diff.tv_sec, t_diff.tv_usec);
-    fprintf(f, "\n%i states removed\n", changed);
-  }
-
+  gpass_stop(g, p, &c);
   return changed;
 }
 
-static int gdfs(GState *s, struct gdfs_state *st) {
-  GTrans *t;
-  GScc *c;
-  GScc *scc = (GScc *)tl_emalloc(sizeof(GScc));
-  scc->gstate = s;
-  scc->rank = st->rank;
-  scc->theta = st->rank++;
-  scc->nxt = st->scc_stack;
-  st->scc_stack = scc;
-
-  s->incoming = 1;
-
-  for (t = s->trans->nxt; t != s->trans; t = t->nxt) {
-    if (t->to->incoming == 0) {
-      int result = gdfs(t->to, st);
-      scc->theta = min(scc->theta, result);
-    }
-    else {
-      for(c = st->scc_stack->nxt; c != 0; c = c->nxt)
-	if(c->gstate == t->to) {
-	  scc->theta = min(scc->theta, c->rank);
-	  break;
-	}
-    }
+/* marks the states whose scc gained or lost states, or became good or bad */
+static void mark_scc_changes(GState **st, int n, const int *old_scc,
+                             int *old_bad, int old_scc_id,
+                             int *bad_scc, int scc_id)
+{
+  int v, *old_to_new, *new_to_old;
+
+  old_to_new = (int *)tl_emalloc((old_scc_id + 1) * sizeof(int));
+  new_to_old = (int *)tl_emalloc((scc_id + 1) * sizeof(int));
+  memset(old_to_new, -1, (old_scc_id + 1) * sizeof(int));
+  memset(new_to_old, -1, (scc_id + 1) * sizeof(int));
+  for(v = 0; v < n; v++) { /* -2 when an scc is split or merged */
+    int o = old_scc[v], c = st[v]->incoming;
+    if(!c) continue; /* not reachable */
+    if(old_to_new[o] != c)
+      old_to_new[o] = (old_to_new[o] == -1) ? c : -2;
+    if(new_to_old[c] != o)
+      new_to_old[c] = (new_to_old[c] == -1) ? o : -2;
   }
-  if(scc->rank == scc->theta) {
-    while(st->scc_stack != scc) {
-      st->scc_stack->gstate->incoming = st->scc_id;
-      st->scc_stack = st->scc_stack->nxt;
-    }
-    scc->gstate->incoming = st->scc_id++;
-    st->scc_stack = scc->nxt;
+  for(v = 0; v < n; v++) {
+    int o = old_scc[v], c = st[v]->incoming;
+    if(c && (old_to_new[o] == -2 || new_to_old[c] == -2 ||
+             in_set(old_bad, o) != in_set(bad_scc, c)))
+      st[v]->dirty |= DIRTY_TRANS | DIRTY_STATES;
   }
-  return scc->theta;
+  tfree(old_to_new);
+  tfree(new_to_old);
 }
 
 static void simplify_gscc(Generalized *g, int *final_set, int **bad_scc,
-                          GState *gremoved)
+                          GState *gremoved, Stage *stage)
 {
-  GState *s;
+  GState *s, **st;
   GTrans *t;
-  int i, **scc_final;
-  struct gdfs_state st;
-  st.rank = 1;
-  st.scc_stack = NULL;
-  st.scc_id = 1;
+  int i, n = 0, e = 0, nroots = 0, scc_id, **scc_final;
+  int *off, *succ, *roots, *scc, *old_scc, old_scc_id = 0, *old_bad;
+  SccWork w;
+  StatsClock c;
+  Pass *p;
 
   if(g->gstates == g->gstates->nxt) return;
+  p = gpass_start(g, stage, LTL2BA_PASS_GSCC, &c);
 
-  for(s = g->gstates->nxt; s != g->gstates; s = s->nxt)
-    s->incoming = 0; /* state color = white */
+  for(s = g->gstates->nxt; s != g->gstates; s = s->nxt) {
+    n++;
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
+      e++;
+  }
 
+  off     = (int *)tl_emalloc((n + 1) * sizeof(int));
+  succ    = (int *)tl_emalloc((e + 1) * sizeof(int));
+  roots   = (int *)tl_emalloc((g->init_size + 1) * sizeof(int));
+  scc     = (int *)tl_emalloc((n + 1) * sizeof(int));
+  st      = (GState **)tl_emalloc((n + 1) * sizeof(GState *));
+  old_scc = (int *)tl_emalloc((n + 1) * sizeof(int));
+  for(s = g->gstates->nxt, n = 0; s != g->gstates; s = s->nxt) {
+    st[n] = s;
+    old_scc[n] = s->incoming; /* scc id computed by the previous call */
+    if(old_scc[n] > old_scc_id) old_scc_id = old_scc[n];
+    s->incoming = n++; /* temporarily numbers the states */
+  }
+  for(s = g->gstates->nxt, e = 0; s != g->gstates; s = s->nxt) {
+    off[s->incoming] = e;
+    for (t = s->trans->nxt; t != s->trans; t = t->nxt)
+      succ[e++] = t->to->incoming;
+  }
+  off[n] = e;
   for(i = 0; i < g->init_size; i++)
-    if(g->init[i] && g->init[i]->incoming == 0)
-      gdfs(g->init[i], &st);
+    if(g->init[i])
+      roots[nroots++] = g->init[i]->incoming;
+
+  scc_work_init(&w, n);
+  scc_id = scc_tarjan(&w, n, off, succ, roots, nroots, scc) + 1;
+  scc_work_free(&w);
+
+  for(s = g->gstates->nxt; s != g->gstates; s = s->nxt)
+    s->incoming = scc[s->incoming] + 1; /* scc id, or 0 if not reachable */
+
+  tfree(off);
+  tfree(succ);
+  tfree(roots);
+  tfree(scc);
 
-  scc_final = (int **)tl_emalloc(st.scc_id * sizeof(int *));
-  for(i = 0; i < st.scc_id; i++)
+  scc_final = (int **)tl_emalloc(scc_id * sizeof(int *));
+  for(i = 0; i < scc_id; i++)
     scc_final[i] = make_set(-1,g->sz.node_size);
 
   for(s = g->gstates->nxt; s != g->gstates; s = s->nxt)
@@ -317,16 +416,25 @@ static void simplify_gscc(Generalized *g, int *final_set, int **bad_scc,
         if(t->to->incoming == s->incoming)
           merge_sets(scc_final[s->incoming], t->final, g->sz.node_size);
 
-  g->scc_size = LTL2BA_SET_SIZE(st.scc_id + 1);
+  old_bad = *bad_scc;
+  g->scc_size = LTL2BA_SET_SIZE(scc_id + 1);
   *bad_scc=make_set(-1, g->scc_size);
 
-  for(i = 0; i < st.scc_id; i++)
+  for(i = 0; i < scc_id; i++)
     if(!included_set(final_set, scc_final[i], g->sz.node_size))
        add_set(*bad_scc, i);
 
-  for(i = 0; i < st.scc_id; i++)
+  for(i = 0; i < scc_id; i++)
     tfree(scc_final[i]);
   tfree(scc_final);
+
+  if(old_bad) { /* the first call finds all the states dirty anyway */
+    mark_scc_changes(st, n, old_scc, old_bad, old_scc_id, *bad_scc, scc_id);
+    tfree(old_bad);
+  }
+  tfree(st);
+  tfree(old_scc);
+  gpass_stop(g, p, &c);
 }
 
 /********************************************************************\
@@ -354,6 +462,24 @@ static int is_final(const set_sizes *sz, int *from, ATrans *at, int i,
   return 0;
 }
 
+/* The states to solve are kept in a stack, doubly linked so that the lazy
+ * construction can take out any of them. */
+static void push_gstate(GState *s, GState *gstack)
+{
+  s->dirty = DIRTY_PENDING;
+  s->nxt = gstack->nxt;
+  s->prv = gstack;
+  s->nxt->prv = s;
+  gstack->nxt = s;
+}
+
+static void pop_gstate(GState *s)
+{
+  s->prv->nxt = s->nxt;
+  s->nxt->prv = s->prv;
+  s->dirty &= ~DIRTY_PENDING;
+}
+
 /* finds the corresponding state, or creates it */
 static GState *find_gstate(Generalized *g, int *set, GState *s, GState *gstack,
                            GState *gremoved)
@@ -385,17 +511,17 @@ static GState *find_gstate(Generalized *g, int *set, GState *s, GState *gstack,
   s->nodes_set = dup_set(set, g->sz.node_size);
   s->trans = emalloc_gtrans(g->sz.sym_size, g->sz.node_size); /* sentinel */
   s->trans->nxt = s->trans;
-  s->nxt = gstack->nxt;
-  gstack->nxt = s;
+  push_gstate(s, gstack);
   return s;
 }
 
-/* creates all the transitions from a state */
+/* creates all the transitions from a state, unless the translation is
+ * stopped: *stop then tells why (never stopped if stop is NULL) */
 static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
-                        Flags flags, int *fin, struct gcounts *c,
-                        int *bad_scc, GState *gstack, GState *gremoved)
+                        Flags flags, int *fin, int *bad_scc, GState *gstack,
+                        GState *gremoved, Status *stop)
 {
-  int i, *list, state_trans = 0, trans_exist = 1;
+  int i, *list, trans_exist = 1;
   GState *s1;
   ATrans *t1;
   AProd *prod = (AProd *)tl_emalloc(sizeof(AProd)); /* initialization */
@@ -423,6 +549,8 @@ static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
 
   while(trans_exist) { /* calculates all the transitions */
     AProd *p = prod->nxt;
+    if(stop && (*stop = check_stop()))
+      break;
     t1 = p->prod;
     if(t1) { /* solves the current transition */
       GTrans *trans, *t2;
@@ -436,16 +564,8 @@ static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
 	   included_set(t1->pos, t2->pos, g->sz.sym_size) &&
 	   included_set(t1->neg, t2->neg, g->sz.sym_size) &&
 	   same_sets(fin, t2->final, g->sz.node_size)) { /* t2 is redondant */
-	  GTrans *free = t2->nxt;
 	  t2->to->incoming--;
-	  t2->to = free->to;
-	  copy_set(free->pos, t2->pos, g->sz.sym_size);
-	  copy_set(free->neg, t2->neg, g->sz.sym_size);
-	  copy_set(free->final, t2->final, g->sz.node_size);
-	  t2->nxt   = free->nxt;
-	  if(free == s->trans) s->trans = t2;
-	  free_gtrans(free, 0, 0);
-	  state_trans--;
+	  delete_gtrans(&g->sz, s, t2);
 	}
 	else if((flags & LTL2BA_SIMP_FLY) &&
 		included_set(t2->to->nodes_set, t1->to, g->sz.node_size) &&
@@ -462,12 +582,12 @@ static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
 	trans = emalloc_gtrans(g->sz.sym_size, g->sz.node_size);
 	trans->to = find_gstate(g, t1->to, s, gstack, gremoved);
 	trans->to->incoming++;
+	link_gtrans(s, trans);
 	copy_set(t1->pos, trans->pos, g->sz.sym_size);
 	copy_set(t1->neg, trans->neg, g->sz.sym_size);
 	copy_set(fin,   trans->final, g->sz.node_size);
 	trans->nxt = s->trans->nxt;
 	s->trans->nxt = trans;
-	state_trans++;
       }
     }
     if(!p->trans)
@@ -496,16 +616,17 @@ static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
   free_atrans(prod->prod, 0);
   tfree(prod);
 
+  if(stop && *stop)
+    return;
+
   if(flags & LTL2BA_SIMP_FLY) {
     if(s->trans == s->trans->nxt) { /* s has no transitions */
+      unlink_all_gtrans(s);
       free_gtrans(s->trans->nxt, s->trans, 1);
       s->trans = (GTrans *)0;
       s->prv = (GState *)0;
       s->nxt = gremoved->nxt;
       gremoved->nxt = s;
-      for(s1 = gremoved->nxt; s1 != gremoved; s1 = s1->nxt)
-	if(s1->prv == s)
-	s1->prv = (GState *)0;
       return;
     }
 
@@ -514,14 +635,12 @@ static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
     while(!all_gtrans_match(g, s, s1, 0, bad_scc))
       s1 = s1->nxt;
     if(s1 != g->gstates) { /* s and s1 are equivalent */
+      unlink_all_gtrans(s);
       free_gtrans(s->trans->nxt, s->trans, 1);
       s->trans = (GTrans *)0;
       s->prv = s1;
       s->nxt = gremoved->nxt;
       gremoved->nxt = s;
-      for(s1 = gremoved->nxt; s1 != gremoved; s1 = s1->nxt)
-	if(s1->prv == s)
-	  s1->prv = s->prv;
       return;
     }
   }
@@ -530,8 +649,65 @@ static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
   s->prv = g->gstates;
   s->nxt->prv = s;
   g->gstates->nxt = s;
-  c->gtrans_count += state_trans;
-  c->gstate_count++;
+}
+
+/* creates the sentinels and puts the initial states in the stack */
+static void init_gstates(Generalized *g, const Alternating *alt,
+                         GState **gstack, GState **gremoved)
+{
+  ATrans *t;
+  GState *s;
+
+  *gstack         = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
+  (*gstack)->nxt  = *gstack;
+  (*gstack)->prv  = *gstack;
+  *gremoved       = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
+  (*gremoved)->nxt = *gremoved;
+  g->gstates      = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
+  g->gstates->nxt = g->gstates;
+  g->gstates->prv = g->gstates;
+
+  for(t = alt->transition[0]; t; t = t->nxt) { /* puts initial states in the stack */
+    s = (GState *)tl_emalloc(sizeof(GState));
+    s->id = (empty_set(t->to, g->sz.node_size)) ? 0 : g->gstate_id++;
+    s->incoming = 1;
+    s->nodes_set = dup_set(t->to, g->sz.node_size);
+    s->trans = emalloc_gtrans(g->sz.sym_size, g->sz.node_size); /* sentinel */
+    s->trans->nxt = s->trans;
+    push_gstate(s, *gstack);
+    g->init_size++;
+  }
+
+  if(g->init_size) g->init = (GState **)tl_emalloc(g->init_size * sizeof(GState *));
+  g->init_size = 0;
+  for(s = (*gstack)->nxt; s != *gstack; s = s->nxt)
+    g->init[g->init_size++] = s;
+}
+
+/********************************************************************\
+|*       Lazy generation of the generalized Buchi automaton         *|
+\********************************************************************/
+
+/* starts the generalized Buchi automaton of lz, whose states are only
+ * solved when expand_gstate() is called on them */
+void lazy_generalized(Lazy *lz)
+{
+  lz->g = (Generalized){ .gstate_id = 1, .sz = lz->alt->sz, };
+  lz->fin = new_set(lz->g.sz.node_size);
+  lz->g.final = list_set(lz->alt->final_set, lz->g.sz.node_size);
+  init_gstates(&lz->g, lz->alt, &lz->gstack, &lz->gremoved);
+}
+
+/* solves the state s of lz if it is still in the stack, and returns the
+ * state that replaces it, or 0 if it has no transitions */
+GState *expand_gstate(Lazy *lz, GState *s)
+{
+  if(s->dirty & DIRTY_PENDING) {
+    pop_gstate(s);
+    make_gtrans(&lz->g, s, lz->alt->transition, lz->flags, lz->fin,
+                (int *)0, lz->gstack, lz->gremoved, (Status *)0);
+  }
+  return gstate_rep(s);
 }
 
 /********************************************************************\
@@ -539,40 +715,44 @@ static void make_gtrans(Generalized *g, GState *s, ATrans **transition,
 \********************************************************************/
 
 /* dumps the generalized Buchi automaton */
-static void reverse_print_generalized(FILE *f, const char *const *sym_table,
+static void reverse_print_generalized(Writer *f, const Symbol *const *sym_table,
                                       const Cexprtab *cexpr, Generalized *g,
                                       GState *s)
 {
+  GState *local[64], **st = local;
+  int sp = 0, size = 64;
   GTrans *t;
-  if(s == g->gstates) return;
-
-  /* begins with the last state */
-  reverse_print_generalized(f, sym_table, cexpr, g, s->nxt);
-
-  fprintf(f, "state %i (", s->id);
-  print_set(f, s->nodes_set, g->sz.node_size);
-  fprintf(f, ") : %i\n", s->incoming);
-  for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
-    if (empty_set(t->pos, g->sz.sym_size) && empty_set(t->neg, g->sz.sym_size))
-      fprintf(f, "1");
-    print_sym_set(f, sym_table, cexpr, t->pos, g->sz.sym_size);
-    if (!empty_set(t->pos, g->sz.sym_size) && !empty_set(t->neg, g->sz.sym_size)) fprintf(f, " & ");
-    print_sym_set(f, sym_table, cexpr, t->neg, g->sz.sym_size);
-    fprintf(f, " -> %i : ", t->to->id);
-    print_set(f, t->final, g->sz.node_size);
-    fprintf(f, "\n");
+
+  for(; s != g->gstates; s = s->nxt)
+    STACK_PUSH(st, sp, size, local, s);
+  while(sp) { /* begins with the last state */
+    s = st[--sp];
+    w_printf(f, "state %i (", s->id);
+    print_set(f, s->nodes_set, g->sz.node_size);
+    w_printf(f, ") : %i\n", s->incoming);
+    for(t = s->trans->nxt; t != s->trans; t = t->nxt) {
+      if (empty_set(t->pos, g->sz.sym_size) && empty_set(t->neg, g->sz.sym_size))
+        w_printf(f, "1");
+      print_sym_set(f, sym_table, cexpr, t->pos, g->sz.sym_size);
+      if (!empty_set(t->pos, g->sz.sym_size) && !empty_set(t->neg, g->sz.sym_size)) w_printf(f, " & ");
+      print_sym_set(f, sym_table, cexpr, t->neg, g->sz.sym_size);
+      w_printf(f, " -> %i : ", t->to->id);
+      print_set(f, t->final, g->sz.node_size);
+      w_printf(f, "\n");
+    }
   }
+  STACK_FREE(st, local);
 }
 
 /* prints intial states and calls 'reverse_print' */
-static void print_generalized(FILE *f, const char *const *sym_table,
+static void print_generalized(Writer *f, const Symbol *const *sym_table,
                               const Cexprtab *cexpr, Generalized *g)
 {
   int i;
-  fprintf(f, "init :\n");
+  w_printf(f, "init :\n");
   for(i = 0; i < g->init_size; i++)
     if(g->init[i])
-      fprintf(f, "%i\n", g->init[i]->id);
+      w_printf(f, "%i\n", g->init[i]->id);
   reverse_print_generalized(f, sym_table, cexpr, g, g->gstates->nxt);
 }
 
@@ -581,91 +761,86 @@ static void print_generalized(FILE *f, const char *const *sym_table,
 \********************************************************************/
 
 Generalized mk_generalized(const Alternating *alt, FILE * tl_out, Flags flags,
-                           const Cexprtab *cexpr)
+                           const Cexprtab *cexpr, Stats *stats)
 { /* generates a generalized Buchi automaton from the alternating automaton */
-  ATrans *t;
   GState *s, *gstack = NULL, *gremoved = NULL;
-  struct rusage tr_debut, tr_fin;
-  struct timeval t_diff;
-  struct gcounts cnts;
-  memset(&cnts, 0, sizeof(cnts));
+  StatsClock stage;
+  Stage *st = stats ? &stats->gen : NULL;
 
   Generalized g = { .gstate_id = 1, .sz = alt->sz, };
 
-  if(flags & LTL2BA_STATS) getrusage(RUSAGE_SELF, &tr_debut);
+  if(st) {
+    stats_stage(st);
+    stats_start(&stage);
+  }
 
   int *fin = new_set(g.sz.node_size);
   int *bad_scc = NULL; /* will be initialized in simplify_gscc */
   g.final = list_set(alt->final_set, g.sz.node_size);
 
-  gstack         = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
-  gstack->nxt    = gstack;
-  gremoved       = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
-  gremoved->nxt  = gremoved;
-  g.gstates      = (GState *)tl_emalloc(sizeof(GState)); /* sentinel */
-  g.gstates->nxt = g.gstates;
-  g.gstates->prv = g.gstates;
-
-  for(t = alt->transition[0]; t; t = t->nxt) { /* puts initial states in the stack */
-    s = (GState *)tl_emalloc(sizeof(GState));
-    s->id = (empty_set(t->to, g.sz.node_size)) ? 0 : g.gstate_id++;
-    s->incoming = 1;
-    s->nodes_set = dup_set(t->to, g.sz.node_size);
-    s->trans = emalloc_gtrans(g.sz.sym_size, g.sz.node_size); /* sentinel */
-    s->trans->nxt = s->trans;
-    s->nxt = gstack->nxt;
-    gstack->nxt = s;
-    g.init_size++;
-  }
-
-  if(g.init_size) g.init = (GState **)tl_emalloc(g.init_size * sizeof(GState *));
-  g.init_size = 0;
-  for(s = gstack->nxt; s != gstack; s = s->nxt)
-    g.init[g.init_size++] = s;
+  init_gstates(&g, alt, &gstack, &gremoved);
 
   while(gstack->nxt != gstack) { /* solves all states in the stack until it is empty */
     s = gstack->nxt;
-    gstack->nxt = gstack->nxt->nxt;
+    pop_gstate(s);
     if(!s->incoming) {
       free_gstate(s);
       continue;
     }
-    make_gtrans(&g, s, alt->transition, flags, fin, &cnts, bad_scc, gstack, gremoved);
+    make_gtrans(&g, s, alt->transition, flags, fin, bad_scc, gstack, gremoved,
+                &g.status);
+    if(g.status) {
+      tfree(gstack);
+      return g;
+    }
   }
 
   retarget_all_gtrans(&g, gremoved);
 
-  if(flags & LTL2BA_STATS) {
-    getrusage(RUSAGE_SELF, &tr_fin);
-    timeval_subtract (&t_diff, &tr_fin.ru_utime, &tr_debut.ru_utime);
-    fprintf(tl_out, "\nBuilding the generalized Buchi automaton : %ld.%06lis",
-		t_diff.tv_sec, t_diff.tv_usec);
-    fprintf(tl_out, "\n%i states, %i transitions\n", cnts.gstate_count, cnts.gtrans_count);
+  if(st) {
+    stats_stop(&stage, &st->build);
+    count_gstates(&g, &st->states, &st->trans);
   }
 
   tfree(gstack);
 
   if(flags & LTL2BA_VERBOSE) {
+    Writer w;
     fprintf(tl_out, "\nGeneralized Buchi automaton before simplification\n");
-    print_generalized(tl_out, alt->sym_table, cexpr, &g);
+    ltl2ba_writer_file(&w, tl_out);
+    print_generalized(&w, alt->sym_table, cexpr, &g);
+    ltl2ba_writer_free(&w);
   }
 
   if(flags & LTL2BA_SIMP_DIFF) {
-    if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved);
-    simplify_gtrans(&g, tl_out, flags, bad_scc);
-    if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved);
-    while(simplify_gstates(&g, tl_out, flags, bad_scc, gremoved)) { /* simplifies as much as possible */
-      if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved);
-      simplify_gtrans(&g, tl_out, flags, bad_scc);
-      if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved);
+    for(s = g.gstates->nxt; s != g.gstates; s = s->nxt)
+      s->dirty = DIRTY_TRANS | DIRTY_STATES; /* everything is examined first */
+    if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved, st);
+    simplify_gtrans(&g, flags, bad_scc, st);
+    if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved, st);
+    while(!(g.status = check_stop()) &&
+          simplify_gstates(&g, flags, bad_scc, gremoved, st)) { /* simplifies as much as possible */
+      if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved, st);
+      simplify_gtrans(&g, flags, bad_scc, st);
+      if (flags & LTL2BA_SIMP_SCC) simplify_gscc(&g, alt->final_set, &bad_scc, gremoved, st);
     }
+    if(g.status)
+      return g;
 
     if(flags & LTL2BA_VERBOSE) {
+      Writer w;
       fprintf(tl_out, "\nGeneralized Buchi automaton after simplification\n");
-      print_generalized(tl_out, alt->sym_table, cexpr, &g);
+      ltl2ba_writer_file(&w, tl_out);
+      print_generalized(&w, alt->sym_table, cexpr, &g);
+      ltl2ba_writer_free(&w);
     }
   }
 
+  if(st) {
+    stats_stop(&stage, &st->time);
+    stats_memory(stats);
+  }
+
   return g;
 }
 
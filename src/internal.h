@@ -35,11 +35,19 @@ typedef ltl2ba_BState      BState;
 typedef ltl2ba_Alternating Alternating;
 typedef ltl2ba_Generalized Generalized;
 typedef ltl2ba_Buchi       Buchi;
+typedef ltl2ba_Lazy        Lazy;
 typedef ltl2ba_Symtab      Symtab;
 typedef ltl2ba_Cexprtab    Cexprtab;
 typedef ltl2ba_Lexer       Lexer;
 typedef ltl2ba_Flags       Flags;
 typedef ltl2ba_set_sizes   set_sizes;
+typedef ltl2ba_Writer      Writer;
+typedef ltl2ba_Status      Status;
+typedef ltl2ba_Stats       Stats;
+typedef ltl2ba_Stage       Stage;
+typedef ltl2ba_Pass        Pass;
+
+#define w_printf   ltl2ba_writer_printf
 
 #define ALWAYS     LTL2BA_ALWAYS
 #define AND        LTL2BA_AND
@@ -55,21 +63,120 @@ typedef ltl2ba_set_sizes   set_sizes;
 #define V_OPER     LTL2BA_V_OPER
 #define NEXT       LTL2BA_NEXT
 
-/* Subtract the `struct timeval' values X and Y, storing the result X-Y in RESULT.
-   Return 1 if the difference is negative, otherwise 0.  */
+void print_sym_name(Writer *f, const Symbol *s, const Cexprtab *cexpr);
+
+/* tells whether the translation must stop, see ltl2ba_set_deadline() */
+Status check_stop(void);
+
+/* the bound of ltl2ba_set_threads(), 0 if none */
+int thread_limit(void);
+
+/* the start of a measure of time */
+typedef struct {
+	struct timespec wall;
+	struct rusage cpu;
+} StatsClock;
+
+void  stats_start(StatsClock *c);
+void  stats_stop(const StatsClock *c, ltl2ba_Time *t); /* time since start */
+void  stats_stage(Stage *st); /* forgets the previous passes */
+Pass *stats_pass(Stage *st, ltl2ba_PassKind kind); /* appends a pass */
+void  stats_memory(Stats *stats); /* cache and pool fields */
+void  cache_stats(Stats *stats);
+void  pool_stats(Stats *stats);
+
+GState *gstate_rep(GState *s);
+void    lazy_generalized(Lazy *lz);
+GState *expand_gstate(Lazy *lz, GState *s);
+
+/* bits of GState::dirty and BState::dirty */
+#define DIRTY_TRANS  1 /* transitions must be simplified again */
+#define DIRTY_STATES 2 /* must be compared again with all other states */
+#define DIRTY_SCAN   4 /* compared with all other states in the current pass */
+#define DIRTY_FINAL  8 /* 'final' changed since ids were last disambiguated */
+#define DIRTY_PENDING 16 /* in the stack of the states to solve */
+
+/* scratch space for scc_tarjan() on graphs of up to 'cap' vertices */
+typedef struct SccWork {
+	int cap;
+	int *index, *low;    /* discovery rank (0 = unvisited) and lowlink */
+	int *stack;          /* Tarjan's stack of vertices */
+	int *call_v, *call_e; /* explicit DFS stack: vertex, next edge */
+	char *on_stack;
+} SccWork;
+
+void scc_work_init(SccWork *w, int n);
+void scc_work_free(SccWork *w);
+int  scc_tarjan(SccWork *w, int n, const int *off, const int *succ,
+                const int *roots, int nroots, int *scc);
+
+/* Explicit stacks for the walks of the formulas, which would otherwise
+ * recurse once per operand of the AND and OR chains. A stack starts in a
+ * local array and moves to the heap when it outgrows it. */
+void *stack_grow(void *v, const void *local, int *size, size_t elem);
+
+#define STACK_RESERVE(st, sp, size, local)                                     \
+	do {                                                                   \
+		if ((sp) == (size))                                            \
+			(st) = stack_grow((st), (local), &(size),              \
+			                  sizeof(*(st)));                      \
+	} while (0)
+
+#define STACK_PUSH(st, sp, size, local, x)                                     \
+	do {                                                                   \
+		STACK_RESERVE(st, sp, size, local);                            \
+		(st)[(sp)++] = (x);                                            \
+	} while (0)
+
+#define STACK_FREE(st, local)                                                  \
+	do {                                                                   \
+		if ((st) != (local))                                           \
+			free(st);                                              \
+	} while (0)
+
+/* A signed node: with neg set, n stands for the negation push_negation()
+ * would build from it. The negation is never built: the type and the
+ * operands of the negated node are read off n. */
 static inline void
-timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
+sgn_norm(const Node **n, int *neg) /* not not p = p */
 {
-	if (x->tv_usec < y->tv_usec) {
-		x->tv_usec += 1000000;
-		x->tv_sec--;
+	if (*neg && *n && (*n)->ntyp == NOT) {
+		*n = (*n)->lft;
+		*neg = 0;
 	}
+}
 
-	/* Compute the time remaining to wait. tv_usec is certainly positive. */
-	result->tv_sec = x->tv_sec - y->tv_sec;
-	result->tv_usec = x->tv_usec - y->tv_usec;
+static inline int
+sgn_ntyp(const Node *n, int neg)
+{
+	if (!neg)
+		return n->ntyp;
+	switch (n->ntyp) {
+	case TRUE:      return FALSE;
+	case FALSE:     return TRUE;
+	case AND:       return OR;
+	case OR:        return AND;
+	case U_OPER:    return V_OPER;
+	case V_OPER:    return U_OPER;
+	case PREDICATE: return NOT;
+	}
+	return n->ntyp; /* NEXT */
 }
 
+/* the left operand of a signed node, whose sign is updated; the other
+ * operands keep the sign of their node */
+static inline const Node *
+sgn_lft(const Node *n, int *neg)
+{
+	if (*neg && n->ntyp == PREDICATE) {
+		*neg = 0;
+		return n;
+	}
+	return n->lft;
+}
+
+int isequal_sgn(const Node *a, int na, const Node *b, int nb);
+
 /* puts the union of the two sets in l1 */
 static inline void merge_sets(int *l1, int *l2, int size)
 {
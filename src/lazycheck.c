@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: GPL-2.0+
+/***** ltl2ba : lazycheck.c *****/
+
+/* Checks the lazy Buchi automaton of mk_lazy_buchi() against the one of
+ * mk_buchi(): for each formula below, both must accept the same words
+ * u v^w, for all u of at most 2 letters and v of 1 or 2 letters. The lazy
+ * automaton is explored until all its states are solved, then the
+ * successors of all the states are asked for again, so that the states
+ * merged or removed on the fly after being reached are retargeted.
+ *
+ * Run by 'make check'.                                                   */
+
+#include "internal.h"
+
+#define MAX_PREFIX 2
+#define MAX_LOOP   2
+#define MAX_WORD   (MAX_PREFIX + MAX_LOOP)
+
+static const char *formulas[] = {
+	"a",
+	"! a",
+	"X a",
+	"a U b",
+	"a V b",
+	"[] <> a",
+	"<> [] a",
+	"[] (a -> <> b)",
+	"[] (a -> X (b U c))",
+	"([] <> a) && ([] <> b)",
+	"(<> [] a) || ([] <> b)",
+	"(a U b) U c",
+	"a U (b && X ! b)",
+	"[] (a || X b) && <> [] ! b",
+	"(a U b) && [] ! b",
+	"X (a && ! a) || [] b",
+	"! ((a U b) V (c U ! a))",
+	"[] (a -> X X b) && <> (c && X ! c)",
+	"(<> a U b) && [] (b -> X ! b)",
+	"[] ((a U b) || (c V ! a))",
+};
+
+static const char *uform = "";
+static int n_merged, n_removed;
+/* the rewrite cache keeps the symbols of the previous formulas */
+static Symtab symtab;
+static Cexprtab cexpr;
+
+/* Buchi automaton over the letters 0 .. 2^sym_id - 1: the transitions of
+ * the state s are off[s] .. off[s+1]-1, the state 0 is the initial one */
+typedef struct {
+	int n, sym_id;
+	BState **state;
+	int *off, *to;
+	unsigned *care, *val;	/* letter l enables t if (l & care[t]) == val[t] */
+} Auto;
+
+char *
+emalloc(int n)
+{
+	char *tmp;
+
+	if (!(tmp = (char *) malloc(n)))
+		fatal("not enough memory");
+	memset(tmp, 0, n);
+	return tmp;
+}
+
+void
+fatal(const char *s1)
+{
+	fprintf(stderr, "lazycheck: %s\n%s\n", s1, uform);
+	exit(1);
+}
+
+void
+tl_yyerror(Lexer *lex, char *s1)
+{
+	fatal(s1);
+}
+
+void
+tl_explain(int n)
+{
+	fprintf(stderr, "%d", n);
+}
+
+void
+dump(FILE *f, const Node *n)
+{
+}
+
+void
+put_uform(Writer *w)
+{
+	w_printf(w, "%s", uform);
+}
+
+static int
+state_index(Auto *a, BState *s)
+{
+	int i;
+
+	for (i = 0; i < a->n; i++)
+		if (a->state[i] == s)
+			return i;
+	return -1;
+}
+
+static void
+add_state(Auto *a, BState *s, int *size)
+{
+	if (a->n == *size)
+	{	BState **st = (BState **) tl_emalloc(2 * *size * sizeof(BState *));
+		memcpy(st, a->state, a->n * sizeof(BState *));
+		tfree(a->state);
+		a->state = st;
+		*size *= 2;
+	}
+	a->state[a->n++] = s;
+}
+
+static unsigned
+letter_mask(int *set, int sym_id)
+{
+	unsigned m = 0;
+	int i;
+
+	for (i = 0; i < sym_id; i++)
+		if (in_set(set, i))
+			m |= 1U << i;
+	return m;
+}
+
+/* makes the tables of a from the transitions of its states, as returned
+ * by succ() */
+static void
+make_auto(Auto *a, BTrans *(*succ)(void *, BState *), void *arg)
+{
+	BTrans *t, *sentinel;
+	int i, k, n = 0;
+
+	for (i = 0; i < a->n; i++)
+		for (sentinel = succ(arg, a->state[i]), t = sentinel->nxt; t != sentinel; t = t->nxt)
+			n++;
+	a->off = (int *) tl_emalloc((a->n + 1) * sizeof(int));
+	a->to = (int *) tl_emalloc((n + 1) * sizeof(int));
+	a->care = (unsigned *) tl_emalloc((n + 1) * sizeof(unsigned));
+	a->val = (unsigned *) tl_emalloc((n + 1) * sizeof(unsigned));
+	for (i = 0, k = 0; i < a->n; i++)
+	{	a->off[i] = k;
+		sentinel = succ(arg, a->state[i]);
+		for (t = sentinel->nxt; t != sentinel; t = t->nxt, k++)
+		{	if (!t->to->trans)
+				fatal("transition to a removed state");
+			if ((a->to[k] = state_index(a, t->to)) < 0)
+				fatal("transition to an unknown state");
+			a->val[k] = letter_mask(t->pos, a->sym_id);
+			a->care[k] = a->val[k] | letter_mask(t->neg, a->sym_id);
+		}
+	}
+	a->off[i] = k;
+}
+
+static void
+free_auto(Auto *a)
+{
+	tfree(a->state);
+	tfree(a->off);
+	tfree(a->to);
+	tfree(a->care);
+	tfree(a->val);
+}
+
+static BTrans *
+lazy_succ(void *lz, BState *s)
+{
+	return lazy_bsuccessors((Lazy *) lz, s);
+}
+
+static BTrans *
+full_succ(void *b, BState *s)
+{
+	return s->trans;
+}
+
+/* the states reachable in the lazy automaton, which are all solved */
+static void
+explore_lazy(Lazy *lz, Auto *a)
+{
+	BTrans *t, *sentinel;
+	BState *s;
+	int i, size = 16;
+
+	a->state = (BState **) tl_emalloc(size * sizeof(BState *));
+	add_state(a, lazy_init_bstate(lz), &size);
+	for (i = 0; i < a->n; i++)
+	{	sentinel = lazy_bsuccessors(lz, a->state[i]);
+		for (t = sentinel->nxt; t != sentinel; t = t->nxt)
+			if (state_index(a, t->to) < 0)
+				add_state(a, t->to, &size);
+	}
+	/* the states merged or removed while the others were solved */
+	for (s = lz->bremoved->nxt; s != lz->bremoved; s = s->nxt)
+		if (state_index(a, s) >= 0)
+		{	if (s->prv)
+				n_merged++;
+			else
+				n_removed++;
+		}
+	make_auto(a, lazy_succ, lz);
+}
+
+static void
+full_auto(Buchi *b, Auto *a)
+{
+	BState *s;
+	int size = 16;
+
+	a->state = (BState **) tl_emalloc(size * sizeof(BState *));
+	for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
+		if (s->id == -1)
+			add_state(a, s, &size);
+	for (s = b->bstates->nxt; s != b->bstates; s = s->nxt)
+		if (s->id != -1)
+			add_state(a, s, &size);
+	make_auto(a, full_succ, b);
+}
+
+/* the state with id 0 accepts everything */
+static int
+accepting(const Auto *a, int q, int accept)
+{
+	return a->state[q]->final == accept || a->state[q]->id == 0;
+}
+
+/* follows the word w[0 .. len-1], looping back to w[loop]: the nodes are
+ * q * len + p, for the state q before the letter w[p] */
+static void
+reach(const Auto *a, const unsigned *w, int len, int loop, int from,
+      char *seen, int *stack)
+{
+	int sp = 0, x, q, p, k, y;
+
+	memset(seen, 0, a->n * len);
+	stack[sp++] = from;
+	while (sp)
+	{	x = stack[--sp];
+		q = x / len;
+		p = x % len;
+		for (k = a->off[q]; k < a->off[q + 1]; k++)
+			if ((w[p] & a->care[k]) == a->val[k])
+			{	y = a->to[k] * len + (p + 1 < len ? p + 1 : loop);
+				if (!seen[y])
+				{	seen[y] = 1;
+					stack[sp++] = y;
+				}
+			}
+	}
+}
+
+/* tests if a accepts w[0 .. loop-1] (w[loop .. len-1])^w */
+static int
+accepts(const Auto *a, int accept, const unsigned *w, int len, int loop)
+{
+	int m = a->n * len, x, ok = 0;
+	char *from_init, *seen;
+	int *stack;
+
+	if (!a->n)	/* empty automaton */
+		return 0;
+	from_init = (char *) tl_emalloc(m);
+	seen = (char *) tl_emalloc(m);
+	stack = (int *) tl_emalloc((m + 1) * sizeof(int));
+	reach(a, w, len, loop, 0, from_init, stack);
+	from_init[0] = 1;
+	for (x = 0; x < m && !ok; x++)
+		if (from_init[x] && accepting(a, x / len, accept))
+		{	if (a->state[x / len]->id == 0)
+				ok = 1;
+			else if (x % len >= loop)
+			{	reach(a, w, len, loop, x, seen, stack);
+				ok = seen[x];
+			}
+		}
+	tfree(from_init);
+	tfree(seen);
+	tfree(stack);
+	return ok;
+}
+
+/* returns the number of words on which the automata disagree */
+static int
+compare(const Auto *a, int a_accept, const Auto *b, int b_accept)
+{
+	unsigned w[MAX_WORD];
+	int letters = 1 << a->sym_id, len, loop, i, n, bad = 0;
+
+	for (loop = 0; loop <= MAX_PREFIX; loop++)
+	for (len = loop + 1; len <= loop + MAX_LOOP; len++)
+	{	for (n = 1, i = 0; i < len; i++)
+			n *= letters;
+		while (n--)
+		{	for (i = 0; i < len; i++)
+				w[i] = (n >> (i * a->sym_id)) & (letters - 1);
+			if (accepts(a, a_accept, w, len, loop) != accepts(b, b_accept, w, len, loop))
+			{	if (!bad++)
+				{	fprintf(stderr, "lazycheck: %s: the automata differ on ", uform);
+					for (i = 0; i < len; i++)
+						fprintf(stderr, "%s%s%#x", i ? " " : "",
+						        i == loop ? "(" : "", w[i]);
+					fprintf(stderr, ")^w\n");
+				}
+			}
+		}
+	}
+	return bad;
+}
+
+static int
+check(const char *formula, Flags flags)
+{
+	Alternating alt;
+	Generalized gen;
+	Buchi b;
+	Lazy lz;
+	Auto lazy = { 0 }, full = { 0 };
+	Node *p;
+	int bad;
+
+	uform = formula;
+	if (!(p = ltl2ba_parse(formula, strlen(formula), symtab, &cexpr, flags)))
+		fatal("syntax error");
+	alt = mk_alternating(p, stderr, &cexpr, flags, NULL);
+	releasenode(1, p);
+
+	lz = mk_lazy_buchi(&alt, flags);
+	lazy.sym_id = alt.sym_id;
+	explore_lazy(&lz, &lazy);
+
+	gen = mk_generalized(&alt, stderr, flags, &cexpr, NULL);
+	b = mk_buchi(&gen, stderr, flags, alt.sym_table, &cexpr, NULL);
+	full.sym_id = alt.sym_id;
+	full_auto(&b, &full);
+
+	bad = compare(&lazy, lz.b.accept, &full, b.accept);
+
+	free_auto(&lazy);
+	free_auto(&full);
+	free_all_atrans();
+	tfree(alt.transition);
+	return bad;
+}
+
+int
+main(void)
+{
+	Flags flags = LTL2BA_SIMP_LOG
+	            | LTL2BA_SIMP_DIFF
+	            | LTL2BA_SIMP_FLY
+	            | LTL2BA_SIMP_SCC
+	            | LTL2BA_FJTOFJ;
+	int i, bad = 0, n = sizeof(formulas) / sizeof(formulas[0]);
+
+	for (i = 0; i < n; i++)
+	{	bad += !!check(formulas[i], flags);
+		bad += !!check(formulas[i], flags & ~LTL2BA_SIMP_FLY);
+	}
+	printf("lazycheck: %d formulas, %d merged and %d removed states, %d failures\n",
+	       n, n_merged, n_removed, bad);
+	free_cexprtab(&cexpr);
+	free_symtab(symtab);
+	/* the retargeting must have been exercised */
+	if (!n_merged || !n_removed)
+	{	fprintf(stderr, "lazycheck: no merged or no removed state\n");
+		bad++;
+	}
+	return bad ? 1 : 0;
+}
@@ -21,28 +21,110 @@ isalnum_(int c)
 {       return (isalnum(c) || c == '_');
 }
 
-static int hash(const char *s)
+/* FNV-1a */
+static unsigned
+hash(const char *s)
+{	unsigned h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	return h;
+}
+
+/* reads the formula in place; tabs, newlines and double quotes read as
+ * spaces, and -1 marks the end */
+static int
+lex_getc(Lexer *lex)
+{	int c;
+
+	if (lex->pos >= lex->len) {
+		lex->pos++;
+		return -1;
+	}
+	c = lex->buf[lex->pos++];
+	return c == '\t' || c == '\n' || c == '"' ? ' ' : c;
+}
+
+static void
+lex_ungetc(Lexer *lex)
 {
-	int h=0;
+	if (lex->pos > 0) lex->pos--;
+}
 
-        while (*s)
-        {       h += *s++;
-                h <<= 1;
-                if (h&(LTL2BA_Nhash+1))
-                        h |= 1;
-        }
-        return h&LTL2BA_Nhash;
+/* sets yytext[i] to c, growing yytext as needed */
+static void
+yytext_put(Lexer *lex, int i, char c)
+{
+	if (i >= lex->yytext_size) {
+		lex->yytext_size = lex->yytext_size ? 2 * lex->yytext_size : 64;
+		lex->yytext = (char *)realloc(lex->yytext, lex->yytext_size);
+		if (!lex->yytext)
+			fatal("not enough memory");
+	}
+	lex->yytext[i] = c;
 }
 
 static void
 getword(Lexer *lex, int first, int (*tst)(int))
 {	int i=0; char c;
 
-	lex->yytext[i++]= (char ) first;
-	while (tst(c = tl_Getchar()))
-		lex->yytext[i++] = c;
-	lex->yytext[i] = '\0';
-	tl_UnGetchar();
+	yytext_put(lex, i++, (char ) first);
+	while (tst(c = lex_getc(lex)))
+		yytext_put(lex, i++, c);
+	yytext_put(lex, i, '\0');
+	lex_ungetc(lex);
+}
+
+static void
+cexpr_rehash(Cexprtab *cexpr, int size)
+{	int i, j;
+
+	free(cexpr->cexpr_hash);
+	cexpr->cexpr_hash = (int *)calloc(size, sizeof(int));
+	if (!cexpr->cexpr_hash)
+		fatal("not enough memory");
+	cexpr->cexpr_hash_size = size;
+	for (i = 0; i < cexpr->cexpr_idx; i++) {
+		j = hash(cexpr->cexpr_expr_table[i]) & (size - 1);
+		while (cexpr->cexpr_hash[j])
+			j = (j + 1) & (size - 1);
+		cexpr->cexpr_hash[j] = i + 1;
+	}
+}
+
+/* returns the index of the C expression s, adding a copy of it if new */
+static int
+cexpr_intern(Cexprtab *cexpr, const char *s)
+{	int j, size;
+
+	if (2 * (cexpr->cexpr_idx + 1) > cexpr->cexpr_hash_size)
+		cexpr_rehash(cexpr, cexpr->cexpr_hash_size ? 2 * cexpr->cexpr_hash_size : 16);
+	size = cexpr->cexpr_hash_size;
+	for (j = hash(s) & (size - 1); cexpr->cexpr_hash[j]; j = (j + 1) & (size - 1))
+		if (!strcmp(cexpr->cexpr_expr_table[cexpr->cexpr_hash[j] - 1], s))
+			return cexpr->cexpr_hash[j] - 1;
+
+	if (cexpr->cexpr_idx == cexpr->cexpr_size) {
+		cexpr->cexpr_size = cexpr->cexpr_size ? 2 * cexpr->cexpr_size : 16;
+		cexpr->cexpr_expr_table = (char **)realloc(cexpr->cexpr_expr_table,
+		                          cexpr->cexpr_size * sizeof(char *));
+		if (!cexpr->cexpr_expr_table)
+			fatal("not enough memory");
+	}
+	cexpr->cexpr_expr_table[cexpr->cexpr_idx] = strdup(s);
+	cexpr->cexpr_hash[j] = cexpr->cexpr_idx + 1;
+	return cexpr->cexpr_idx++;
+}
+
+void
+free_cexprtab(Cexprtab *cexpr)
+{	int i;
+
+	for (i = 0; i < cexpr->cexpr_idx; i++)
+		free(cexpr->cexpr_expr_table[i]);
+	free(cexpr->cexpr_expr_table);
+	free(cexpr->cexpr_hash);
+	memset(cexpr, 0, sizeof(*cexpr));
 }
 
 static int
@@ -50,9 +132,9 @@ follow(Lexer *lex, int tok, int ifyes, int ifno)
 {	int c;
 	char buf[32];
 
-	if ((c = tl_Getchar()) == tok)
+	if ((c = lex_getc(lex)) == tok)
 		return ifyes;
-	tl_UnGetchar();
+	lex_ungetc(lex);
 	lex->tl_yychar = c;
 	sprintf(buf, "expected '%c'", tok);
 	tl_yyerror(lex, buf);	/* no return from here */
@@ -64,52 +146,39 @@ tl_lex(Symtab symtab, Cexprtab *cexpr, Lexer *lex)
 {	int c;
 
 	do {
-		c = tl_Getchar();
-		lex->yytext[0] = (char ) c;
-		lex->yytext[1] = '\0';
+		c = lex_getc(lex);
+		yytext_put(lex, 0, (char ) c);
+		yytext_put(lex, 1, '\0');
 
 		if (c <= 0)
 		{	Token(';');
 		}
 
-	} while (c == ' ');	/* '\t' is removed in tl_main.c */
+	} while (c == ' ');	/* lex_getc() maps '\t' to ' ' */
 
 	if (c == '{') {
-		char buffer[256];
+		char buffer[64];
 		int idx = 0;
 
 		do {
-			c = tl_Getchar();
+			c = lex_getc(lex);
 			if (c == '}')
 				break;
 
 			if (c <= 0)
 				tl_yyerror(lex, "Unexpected end of file during C expression");
 
-			lex->yytext[idx++] = c;
-			if (idx == 2048)
-				tl_yyerror(lex, "Your C expression is too long");
+			yytext_put(lex, idx++, c);
 		} while (1);
 
-		lex->yytext[idx++] = '\0';
-		cexpr->cexpr_expr_table[cexpr->cexpr_idx] = (char *)strdup(lex->yytext);
-
-		for (idx = 0; idx < cexpr->cexpr_idx; idx++) {
-			if (!strcmp(cexpr->cexpr_expr_table[cexpr->cexpr_idx],
-			            cexpr->cexpr_expr_table[idx])) {
-				sprintf(buffer, "_ltl2ba_cexpr_%d_status",idx);
-				break;
-			}
-		}
-
-		if (idx == cexpr->cexpr_idx)
-			sprintf(buffer, "_ltl2ba_cexpr_%d_status", cexpr->cexpr_idx++);
-
-		if (cexpr->cexpr_idx == 256)
-			tl_yyerror(lex, "You have too many C expressions");
+		yytext_put(lex, idx, '\0');
+		idx = cexpr_intern(cexpr, lex->yytext);
+		sprintf(buffer, "_ltl2ba_cexpr_%d_status", idx);
 
 		lex->tl_yylval = tl_nn(PREDICATE,NULL,NULL);
 		lex->tl_yylval->sym = tl_lookup(symtab, buffer);
+		lex->tl_yylval->sym->kind = LTL2BA_SYM_CEXPR;
+		lex->tl_yylval->sym->cexpr = idx;
 		return PREDICATE;
 	}
 
@@ -127,32 +196,32 @@ tl_lex(Symtab symtab, Cexprtab *cexpr, Lexer *lex)
 		return PREDICATE;
 	}
 	if (c == '<')
-	{	c = tl_Getchar();
+	{	c = lex_getc(lex);
 		if (c == '>')
 		{	Token(EVENTUALLY);
 		}
 		if (c != '-')
-		{	tl_UnGetchar();
+		{	lex_ungetc(lex);
 			tl_yyerror(lex, "expected '<>' or '<->'");
 		}
-		c = tl_Getchar();
+		c = lex_getc(lex);
 		if (c == '>')
 		{	Token(EQUIV);
 		}
-		tl_UnGetchar();
+		lex_ungetc(lex);
 		tl_yyerror(lex, "expected '<->'");
 	}
 	if (c == 'N')
-	{	c = tl_Getchar();
+	{	c = lex_getc(lex);
 		if (c != 'O')
-		{	tl_UnGetchar();
+		{	lex_ungetc(lex);
 			tl_yyerror(lex, "expected 'NOT'");
 		}
-		c = tl_Getchar();
+		c = lex_getc(lex);
 		if (c == 'T')
 		{	Token(NOT);
 		}
-		tl_UnGetchar();
+		lex_ungetc(lex);
 		tl_yyerror(lex, "expected 'NOT'");
 	}
 
@@ -183,20 +252,86 @@ tl_yylex(Symtab symtab, Cexprtab *cexpr, Lexer *lex)
 	return c;
 }
 
+/* chunk of storage of the symbols, released all at once */
+struct ltl2ba_Arena {
+	struct ltl2ba_Arena *next;
+	size_t used, size;
+	char data[];
+};
+
+#define ARENA_CHUNK 8192
+
+/* returns n zeroed bytes, aligned for a Symbol */
+static void *
+arena_alloc(struct ltl2ba_Arena **arena, size_t n)
+{	struct ltl2ba_Arena *a = *arena;
+	size_t size;
+
+	n = (n + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	if (!a || a->used + n > a->size) {
+		size = n > ARENA_CHUNK ? n : ARENA_CHUNK;
+		a = (struct ltl2ba_Arena *)calloc(1, sizeof(*a) + size);
+		if (!a)
+			fatal("not enough memory");
+		a->size = size;
+		a->next = *arena;
+		*arena = a;
+	}
+	a->used += n;
+	return a->data + a->used - n;
+}
+
+static void
+symtab_rehash(Symtab symtab, int size)
+{	Symbol **slots = (Symbol **)calloc(size, sizeof(Symbol *));
+	int i, j;
+
+	if (!slots)
+		fatal("not enough memory");
+	for (i = 0; i < symtab->size; i++)
+		if (symtab->slots[i]) {
+			j = hash(symtab->slots[i]->name) & (size - 1);
+			while (slots[j])
+				j = (j + 1) & (size - 1);
+			slots[j] = symtab->slots[i];
+		}
+	free(symtab->slots);
+	symtab->slots = slots;
+	symtab->size = size;
+}
+
 Symbol * tl_lookup(Symtab symtab, const char *s)
 {
 	Symbol *sp;
-	int h = hash(s);
+	size_t len;
+	int h;
 
-	for (sp = symtab[h]; sp; sp = sp->next)
+	if (2 * (symtab->count + 1) > symtab->size)
+		symtab_rehash(symtab, symtab->size ? 2 * symtab->size : 64);
+
+	for (h = hash(s) & (symtab->size - 1); (sp = symtab->slots[h]);
+	     h = (h + 1) & (symtab->size - 1))
 		if (strcmp(sp->name, s) == 0)
 			return sp;
 
-	sp = tl_emalloc(sizeof(Symbol));
-	sp->name = tl_emalloc(strlen(s) + 1);
-	strcpy(sp->name, s);
-	sp->next = symtab[h];
-	symtab[h] = sp;
+	len = strlen(s) + 1;
+	sp = (Symbol *)arena_alloc(&symtab->arena, sizeof(Symbol) + len);
+	sp->name = (char *)(sp + 1);
+	memcpy(sp->name, s, len);
+	symtab->slots[h] = sp;
+	symtab->count++;
 
 	return sp;
 }
+
+void free_symtab(Symtab symtab)
+{
+	struct ltl2ba_Arena *a, *next;
+
+	for (a = symtab->arena; a; a = next) {
+		next = a->next;
+		free(a);
+	}
+	free(symtab->slots);
+	memset(symtab, 0, sizeof(*symtab));
+}
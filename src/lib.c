@@ -1,12 +1,121 @@
-
-#include <ltl2ba.h>
+#include "internal.h"
 
 #define STR(x)	#x
 #define XSTR(x)	STR(x)
 
+static struct timespec deadline;
+static int has_deadline, deadline_passed;
+static const volatile sig_atomic_t *cancel_flag;
+static int max_threads;
+
 const char * ltl2ba_version(void)
 {
   static const char version[] = XSTR(LTL2BA_VERSION_MAJOR) "."
                                 XSTR(LTL2BA_VERSION_MINOR);
   return version;
 }
+
+void ltl2ba_set_deadline(const struct timespec *t)
+{
+  has_deadline = t != NULL;
+  if(t)
+    deadline = *t;
+  deadline_passed = 0;
+}
+
+void ltl2ba_set_cancel(const volatile sig_atomic_t *flag)
+{
+  cancel_flag = flag;
+}
+
+void ltl2ba_set_threads(int n)
+{
+  max_threads = n < 0 ? 0 : n;
+}
+
+int thread_limit(void)
+{
+  return max_threads;
+}
+
+/* Reading CLOCK_MONOTONIC costs no system call on the usual systems, which
+ * is small beside an iteration of the loops calling this. A passed deadline
+ * stays passed until the next ltl2ba_set_deadline(). */
+Status check_stop(void)
+{
+  struct timespec now;
+
+  if(cancel_flag && *cancel_flag)
+    return LTL2BA_CANCELLED;
+  if(!has_deadline)
+    return LTL2BA_OK;
+  if(!deadline_passed) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    deadline_passed = now.tv_sec > deadline.tv_sec ||
+                      (now.tv_sec == deadline.tv_sec &&
+                       now.tv_nsec >= deadline.tv_nsec);
+  }
+  return deadline_passed ? LTL2BA_DEADLINE : LTL2BA_OK;
+}
+
+void stats_start(StatsClock *c)
+{
+  clock_gettime(CLOCK_MONOTONIC, &c->wall);
+  getrusage(RUSAGE_SELF, &c->cpu);
+}
+
+static double seconds(const struct timeval *t)
+{
+  return t->tv_sec + t->tv_usec / 1e6;
+}
+
+void stats_stop(const StatsClock *c, ltl2ba_Time *t)
+{
+  StatsClock now;
+
+  stats_start(&now);
+  t->wall = (now.wall.tv_sec - c->wall.tv_sec) +
+            (now.wall.tv_nsec - c->wall.tv_nsec) / 1e9;
+  t->cpu = seconds(&now.cpu.ru_utime) - seconds(&c->cpu.ru_utime) +
+           seconds(&now.cpu.ru_stime) - seconds(&c->cpu.ru_stime);
+}
+
+void stats_stage(Stage *st)
+{
+  Pass *passes = st->passes;
+  int passes_size = st->passes_size;
+
+  memset(st, 0, sizeof(*st));
+  st->passes = passes;
+  st->passes_size = passes_size;
+}
+
+Pass *stats_pass(Stage *st, ltl2ba_PassKind kind)
+{
+  Pass *p;
+
+  if(st->npasses == st->passes_size) {
+    st->passes_size = st->passes_size ? 2 * st->passes_size : 8;
+    st->passes = (Pass *)realloc(st->passes, st->passes_size * sizeof(Pass));
+    if(!st->passes)
+      fatal("not enough memory\n");
+  }
+  p = &st->passes[st->npasses++];
+  memset(p, 0, sizeof(*p));
+  p->kind = kind;
+  return p;
+}
+
+void stats_memory(Stats *stats)
+{
+  cache_stats(stats);
+  pool_stats(stats);
+}
+
+void ltl2ba_free_stats(Stats *stats)
+{
+  free(stats->alt.passes);
+  free(stats->gen.passes);
+  free(stats->buchi.passes);
+  memset(stats, 0, sizeof(*stats));
+}
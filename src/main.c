@@ -14,13 +14,15 @@
 #include "internal.h"
 
 static int	tl_errs      = 0;
+static int	tl_stats     = 0;
+static Stats	stats;
 
-static char	uform[4096];
-static int	hasuform=0, cnt=0;
+static const char *uform = "";
 
 enum out {
 	OUT_SPIN,
 	OUT_C,
+	OUT_C_TABLE,
 	OUT_DOT
 };
 
@@ -45,24 +47,28 @@ emalloc(int n)
 	return tmp;
 }
 
-int
-tl_Getchar(void)
+static int
+uform_char(int c)	/* as the lexer reads it */
 {
-	if (cnt < hasuform)
-		return uform[cnt++];
-	cnt++;
-	return -1;
+	return c == '\t' || c == '\n' || c == '"' ? ' ' : c;
 }
 
-void put_uform(FILE *f)
-{
-	fprintf(f, "%s", uform);
+void put_uform(Writer *w)
+{	const char *s;
+	char c;
+
+	for (s = uform; *s; s++)
+	{	c = uform_char(*s);
+		ltl2ba_writer_write(w, &c, 1);
+	}
 }
 
-void
-tl_UnGetchar(void)
-{
-	if (cnt > 0) cnt--;
+static void
+fput_uform(FILE *f)
+{	const char *s;
+
+	for (s = uform; *s; s++)
+		fputc(uform_char(*s), f);
 }
 
 static void
@@ -83,8 +89,9 @@ usage: %s [-flag] -f 'formula'\n\
  -o            disable (O)n-the-fly simplification\n\
  -c            disable strongly (C)onnected components simplification\n\
  -a            disable trick in (A)ccepting conditions\n\
- -O mode       output mode; one of spin, c or dot\n\
+ -O mode       output mode; one of spin, c, ctable or dot\n\
  -C            dump cache info at the end\n\
+ -T seconds    give up the translation after that time\n\
  -H C_HEADER   optional #include identifier of a header with extern symbol\n\
                declarations for C output, either in \"quotes\" or in <brackets>\n\
 ", progname, (int)strlen(progname), "");
@@ -93,33 +100,42 @@ usage: %s [-flag] -f 'formula'\n\
 
 static char *cmdline;
 
+/* reports a stopped translation */
+static int stopped(Status status)
+{
+	if (status == LTL2BA_OK)
+		return 0;
+	fprintf(stderr, "%s: translation stopped: %s\n", progname,
+	        status == LTL2BA_DEADLINE ? "time limit reached" : "cancelled");
+	tl_errs++;
+	return 1;
+}
+
 static void tl_main(char *formula, enum out outmode, Flags flags,
                     const char *c_sym_name_prefix, const char *extern_c_header)
 {
-	for (int i = 0; formula[i]; i++)
-		if (formula[i] == '\t'
-		||  formula[i] == '\"'
-		||  formula[i] == '\n')
-			formula[i] = ' ';
-
-	strcpy(uform, formula);
-	hasuform = strlen(uform);
-
 	Symtab symtab;
-	memset(&symtab, 0, sizeof(symtab));
 	Cexprtab cexpr;
+	Stats *st = tl_stats ? &stats : NULL;
+	Alternating alt;
+	Generalized gen;
+	Buchi b;
+	Writer out;
+	Status status = LTL2BA_OK;
+
+	uform = formula;
+	memset(&symtab, 0, sizeof(symtab));
 	memset(&cexpr, 0, sizeof(cexpr));
 
-	Node *p = tl_parse(symtab, &cexpr, flags);
+	Node *p = ltl2ba_parse(formula, strlen(formula), symtab, &cexpr, flags);
 	if (flags & LTL2BA_VERBOSE)
-	{
-		fprintf(stderr, "formula: ");
-		put_uform(stderr);
+	{	fprintf(stderr, "formula: ");
+		fput_uform(stderr);
 		fprintf(stderr, "\n");
 	}
 
 	if (!p || tl_errs)
-		return;
+		goto done;
 
 	if (flags & LTL2BA_VERBOSE) {
 		fprintf(stderr, "\t/* Normlzd: ");
@@ -127,33 +143,52 @@ static void tl_main(char *formula, enum out outmode, Flags flags,
 		fprintf(stderr, " */\n");
 	}
 
-	Alternating alt = mk_alternating(p, stderr, &cexpr, flags);
+	alt = mk_alternating(p, stderr, &cexpr, flags, st);
 	releasenode(1, p);
 
-	Generalized gen = mk_generalized(&alt, stderr, flags, &cexpr);
+	gen = mk_generalized(&alt, stderr, flags, &cexpr, st);
+	if (stopped(gen.status))
+		goto stats;
 	// free the data from the alternating automaton
 	/* for(i = 0; i < alt->node_id; i++)
 		free_atrans(transition[i], 1); */
 	free_all_atrans();
 	tfree(alt.transition);
 
-	Buchi b = mk_buchi(&gen, stderr, flags, alt.sym_table, &cexpr);
+	b = mk_buchi(&gen, stderr, flags, alt.sym_table, &cexpr, st);
+	if (stopped(b.status))
+		goto stats;
 
+	/* kept until complete, so that a stopped translation prints nothing */
+	ltl2ba_writer_buffer(&out);
 	switch (outmode) {
 	case OUT_SPIN:
-		print_spin_buchi(stdout, &b, alt.sym_table);
+		print_spin_buchi(&out, &b, alt.sym_table);
 		break;
 	case OUT_C:
-		print_c_buchi(stdout, &b, alt.sym_table, &cexpr, alt.sym_id,
-		              c_sym_name_prefix, extern_c_header, cmdline);
+		status = print_c_buchi(&out, &b, alt.sym_table, &cexpr,
+		                       alt.sym_id, c_sym_name_prefix,
+		                       extern_c_header, cmdline);
+		break;
+	case OUT_C_TABLE:
+		status = print_c_table_buchi(&out, &b, alt.sym_table, &cexpr,
+		                             alt.sym_id, c_sym_name_prefix,
+		                             extern_c_header, cmdline);
 		break;
 	case OUT_DOT:
-		print_dot_buchi(stdout, &b, alt.sym_table, &cexpr);
+		print_dot_buchi(&out, &b, alt.sym_table, &cexpr);
 		break;
 	}
+	if (!stopped(status) && out.len)
+		fwrite(out.buf, 1, out.len, stdout);
+	ltl2ba_writer_free(&out);
 
-	if (flags & LTL2BA_STATS)
+stats:
+	if (tl_stats)
 		tl_endstats();
+done:
+	free_cexprtab(&cexpr);
+	free_symtab(symtab);
 }
 
 static void free_cmdline(void)
@@ -177,6 +212,8 @@ int main(int argc, char *argv[])
 	const char *c_sym_name_prefix = "_ltl2ba";
 	const char *extern_c_header = NULL;
 	int display_cache = 0;
+	double time_limit = 0;
+	char *end;
 
 	atexit(free_cmdline);
 
@@ -197,7 +234,7 @@ int main(int argc, char *argv[])
 	if (!strcmp(progname, "ltl2c"))
 		outmode = OUT_C;
 
-	for (int opt; (opt = getopt(argc, argv, ":hF:f:acopldsO:PiCH:")) != -1;)
+	for (int opt; (opt = getopt(argc, argv, ":hF:f:acopldsO:PiCH:T:")) != -1;)
 		switch (opt) {
 		case 'h': usage(0); break;
 		case 'F': ltl_file = optarg; break;
@@ -208,12 +245,14 @@ int main(int argc, char *argv[])
 		case 'p': flags &= ~LTL2BA_SIMP_DIFF; break;
 		case 'l': flags &= ~LTL2BA_SIMP_LOG; break;
 		case 'd': flags |= LTL2BA_VERBOSE; break;
-		case 's': flags |= LTL2BA_STATS; break;
+		case 's': tl_stats = 1; break;
 		case 'O':
 			if (strcmp("spin", optarg) == 0)
 				outmode = OUT_SPIN;
 			else if (strcmp("c", optarg) == 0)
 				outmode = OUT_C;
+			else if (strcmp("ctable", optarg) == 0)
+				outmode = OUT_C_TABLE;
 			else if (strcmp("dot", optarg) == 0)
 				outmode = OUT_DOT;
 			else
@@ -223,6 +262,11 @@ int main(int argc, char *argv[])
 		case 'i': invert_formula = 1; break;
 		case 'C': display_cache = 1; break;
 		case 'H': extern_c_header = optarg; break;
+		case 'T':
+			time_limit = strtod(optarg, &end);
+			if (*end || !(time_limit > 0))
+				usage(1);
+			break;
 		case ':':
 		case '?': usage(1); break;
 		}
@@ -262,10 +306,23 @@ int main(int argc, char *argv[])
 		add_ltl = inv_formula;
 	}
 
+	if (time_limit > 0) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += (time_t)time_limit;
+		deadline.tv_nsec += (long)((time_limit - (time_t)time_limit) * 1e9);
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		ltl2ba_set_deadline(&deadline);
+	}
+
 	tl_main(add_ltl, outmode, flags, c_sym_name_prefix, extern_c_header);
 
 	free(formula);
 	free(inv_formula);
+	ltl2ba_free_stats(&stats);
 
 	if (display_cache)
 		cache_dump();
@@ -273,59 +330,135 @@ int main(int argc, char *argv[])
 	return tl_errs != 0;
 }
 
+static const char *pass_names[] = {
+	[LTL2BA_PASS_ASTATES] = "states",
+	[LTL2BA_PASS_GTRANS]  = "transitions",
+	[LTL2BA_PASS_GSTATES] = "states",
+	[LTL2BA_PASS_GSCC]    = "scc",
+	[LTL2BA_PASS_BTRANS]  = "transitions",
+	[LTL2BA_PASS_BSTATES] = "states",
+	[LTL2BA_PASS_BSCC]    = "scc",
+};
+
+static void
+print_stage(const char *name, const Stage *st)
+{
+	int i;
+
+	fprintf(stderr, "\nBuilding the %s: %.6fs (%.6fs wall)\n",
+		name, st->build.cpu, st->build.wall);
+	fprintf(stderr, "%i states, %i transitions\n", st->states, st->trans);
+	for (i = 0; i < st->npasses; i++)
+	{	const Pass *p = &st->passes[i];
+		fprintf(stderr, "Simplification of the %s - %s: %.6fs (%.6fs wall)\n",
+			name, pass_names[p->kind], p->time.cpu, p->time.wall);
+		fprintf(stderr, "%i -> %i states, %i -> %i transitions\n",
+			p->states_before, p->states_after,
+			p->trans_before, p->trans_after);
+	}
+	fprintf(stderr, "Total for the %s: %.6fs (%.6fs wall)\n",
+		name, st->time.cpu, st->time.wall);
+}
+
+static void
+print_pool(const char *name, const ltl2ba_PoolStats *p)
+{
+	fprintf(stderr, "%s\t%6ld\t%6ld\t%6ld\n",
+		name, p->pool, p->allocs, p->frees);
+}
+
 static void
 tl_endstats(void)
 {
-	/*cache_stats();*/
-	a_stats();
+	char size[16];
+	int i;
+
+	print_stage("alternating automaton", &stats.alt);
+	print_stage("generalized Buchi automaton", &stats.gen);
+	print_stage("Buchi automaton", &stats.buchi);
+
+	fprintf(stderr, "\ncache stores     : %9ld\n", stats.cache_stores);
+	fprintf(stderr, "cache hits       : %9ld\n", stats.cache_hits);
+	fprintf(stderr, "total memory used: %9lu\n", stats.mem_total);
+	fprintf(stderr, " size\t  pool\tallocs\t frees\n");
+	for (i = 0; i < LTL2BA_POOL_SIZES; i++)
+		if (stats.sizes[i].pool | stats.sizes[i].allocs | stats.sizes[i].frees)
+		{	snprintf(size, sizeof(size), "%5d", i);
+			print_pool(size, &stats.sizes[i]);
+		}
+	print_pool("atrans", &stats.atrans);
+	print_pool("gtrans", &stats.gtrans);
+	print_pool("btrans", &stats.btrans);
 }
 
+/* what dump() has left to write: a formula, or the text s */
+typedef struct {
+	const Node *n;
+	const char *s;
+} DumpItem;
+
+#define Later(x, t)	{ STACK_RESERVE(st, sp, size, local);	\
+			  st[sp].n = (x);			\
+			  st[sp++].s = (t); }
+
 #define Binop(a)		\
 	fprintf(f, "(");	\
-	dump(f, n->lft);	\
-	fprintf(f, a);		\
-	dump(f, n->rgt);	\
-	fprintf(f, ")")
+	Later(NULL, ")");	\
+	Later(n->rgt, NULL);	\
+	Later(NULL, a);		\
+	Later(n->lft, NULL)
 
 void dump(FILE *f, const Node *n)
 {
-	if (!n)
-		return;
-
-	switch(n->ntyp) {
-	case OR:	Binop(" || "); break;
-	case AND:	Binop(" && "); break;
-	case U_OPER:	Binop(" U ");  break;
-	case V_OPER:	Binop(" V ");  break;
-	case NEXT:
-		fprintf(f, "X");
-		fprintf(f, " (");
-		dump(f, n->lft);
-		fprintf(f, ")");
-		break;
-	case NOT:
-		fprintf(f, "!");
-		fprintf(f, " (");
-		dump(f, n->lft);
-		fprintf(f, ")");
-		break;
-	case FALSE:
-		fprintf(f, "false");
-		break;
-	case TRUE:
-		fprintf(f, "true");
-		break;
-	case PREDICATE:
-		fprintf(f, "(%s)", n->sym->name);
-		break;
-	case -1:
-		fprintf(f, " D ");
-		break;
-	default:
-		fprintf(stderr,"Unknown token: ");
-		tl_explain(n->ntyp);
-		break;
+	DumpItem local[64], *st = local;
+	int sp = 0, size = 64;
+
+	Later(n, NULL);
+	while (sp)
+	{	n = st[--sp].n;
+		if (st[sp].s)
+		{	fprintf(f, "%s", st[sp].s);
+			continue;
+		}
+		if (!n)
+			continue;
+
+		switch(n->ntyp) {
+		case OR:	Binop(" || "); break;
+		case AND:	Binop(" && "); break;
+		case U_OPER:	Binop(" U ");  break;
+		case V_OPER:	Binop(" V ");  break;
+		case NEXT:
+			fprintf(f, "X");
+			fprintf(f, " (");
+			Later(NULL, ")");
+			Later(n->lft, NULL);
+			break;
+		case NOT:
+			fprintf(f, "!");
+			fprintf(f, " (");
+			Later(NULL, ")");
+			Later(n->lft, NULL);
+			break;
+		case FALSE:
+			fprintf(f, "false");
+			break;
+		case TRUE:
+			fprintf(f, "true");
+			break;
+		case PREDICATE:
+			fprintf(f, "(%s)", n->sym->name);
+			break;
+		case -1:
+			fprintf(f, " D ");
+			break;
+		default:
+			fprintf(stderr,"Unknown token: ");
+			tl_explain(n->ntyp);
+			break;
+		}
 	}
+	STACK_FREE(st, local);
 }
 
 void
@@ -351,7 +484,7 @@ tl_explain(int n)
 }
 
 static void
-non_fatal(int tl_yychar, const char *s1)
+non_fatal(int tl_yychar, const char *s1, size_t pos)
 {
 	int i;
 
@@ -362,8 +495,10 @@ non_fatal(int tl_yychar, const char *s1)
 		tl_explain(tl_yychar);
 		fprintf(stderr,"'");
 	}
-	fprintf(stderr,"\n%s: %s\n", progname, uform);
-	int n = cnt + strlen(progname) + 2 - 1;
+	fprintf(stderr,"\n%s: ", progname);
+	fput_uform(stderr);
+	fprintf(stderr,"\n");
+	int n = pos + strlen(progname) + 2 - 1;
 	for (i = 0; i < n; i++)
 		fprintf(stderr,"-");
 	fprintf(stderr,"^\n");
@@ -374,13 +509,13 @@ non_fatal(int tl_yychar, const char *s1)
 void
 tl_yyerror(Lexer *lex, char *s1)
 {
-	non_fatal(lex->tl_yychar, s1);
+	non_fatal(lex->tl_yychar, s1, lex->pos);
 	alldone(1);
 }
 
 void
 fatal(const char *s1)
 {
-	non_fatal(0, s1);
+	non_fatal(0, s1, strlen(uform) + 1);
 	alldone(1);
 }
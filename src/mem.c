@@ -17,7 +17,7 @@
 #define log(e, u, d)
 #endif
 
-#define A_LARGE		80
+#define A_LARGE		LTL2BA_POOL_SIZES
 #define A_USER		0x55000000
 #define NOTOOBIG	32768
 
@@ -107,6 +107,24 @@ tfree(void *v)
 	}
 }
 
+/* doubles the explicit stack v of *size elements of elem bytes, which starts
+ * in the local array and moves to the heap */
+void *
+stack_grow(void *v, const void *local, int *size, size_t elem)
+{	void *w;
+
+	if (v == local)
+	{	w = malloc(2 * *size * elem);
+		if (w)
+			memcpy(w, v, *size * elem);
+	} else
+		w = realloc(v, 2 * *size * elem);
+	if (!w)
+		fatal("not enough memory");
+	*size *= 2;
+	return w;
+}
+
 ATrans* emalloc_atrans(int sym_size, int node_size) {
   ATrans *result;
   if(!atrans_list) {
@@ -125,12 +143,14 @@ ATrans* emalloc_atrans(int sym_size, int node_size) {
   return result;
 }
 
-void free_atrans(ATrans *t, int rec) {
+void free_atrans(ATrans *t, int rec) { /* the list keeps its order */
+  ATrans *last = t;
   if(!t) return;
-  if(rec) free_atrans(t->nxt, rec);
-  t->nxt = atrans_list;
-  atrans_list = t;
   afrees++;
+  for(; rec && last->nxt; last = last->nxt)
+    afrees++;
+  last->nxt = atrans_list;
+  atrans_list = t;
 }
 
 void free_all_atrans() {
@@ -163,12 +183,13 @@ GTrans* emalloc_gtrans(int sym_size, int node_size) {
 }
 
 void free_gtrans(GTrans *t, GTrans *sentinel, int fly) {
+  GTrans *last = t; /* the list up to the sentinel keeps its order */
   gfrees++;
-  if(sentinel && (t != sentinel)) {
-    free_gtrans(t->nxt, sentinel, fly);
-    if(fly) t->to->incoming--;
+  for(; sentinel && (last != sentinel); last = last->nxt) {
+    gfrees++;
+    if(fly) last->to->incoming--;
   }
-  t->nxt = gtrans_list;
+  last->nxt = gtrans_list;
   gtrans_list = t;
 }
 
@@ -189,40 +210,33 @@ BTrans* emalloc_btrans(int sym_size) {
 }
 
 void free_btrans(BTrans *t, BTrans *sentinel, int fly) {
+  BTrans *last = t; /* the list up to the sentinel keeps its order */
   bfrees++;
-  if(sentinel && (t != sentinel)) {
-    free_btrans(t->nxt, sentinel, fly);
-    if(fly) t->to->incoming--;
+  for(; sentinel && (last != sentinel); last = last->nxt) {
+    bfrees++;
+    if(fly) last->to->incoming--;
   }
-  t->nxt = btrans_list;
+  last->nxt = btrans_list;
   btrans_list = t;
 }
 
-void a_stats(void)
+void pool_stats(Stats *stats)
 {
-	long p, a, f;
 	int i;
 
-	/*extern int Stack_mx;*/
-	fprintf(stderr, "\ntotal memory used: %9ld\n", All_Mem);
-	/*fprintf(stderr, "largest stack sze: %9d\n", Stack_mx);*/
-
-	fprintf(stderr, " size\t  pool\tallocs\t frees\n");
-
+	stats->mem_total = All_Mem;
 	for (i = 0; i < A_LARGE; i++)
-	{	p = event[POOL][i];
-		a = event[ALLOC][i];
-		f = event[FREE][i];
-
-		if(p|a|f)
-		fprintf(stderr, "%5d\t%6ld\t%6ld\t%6ld\n",
-			i, p, a, f);
+	{	stats->sizes[i].pool   = event[POOL][i];
+		stats->sizes[i].allocs = event[ALLOC][i];
+		stats->sizes[i].frees  = event[FREE][i];
 	}
-
-	fprintf(stderr, "atrans\t%6d\t%6d\t%6d\n",
-	       apool, aallocs, afrees);
-	fprintf(stderr, "gtrans\t%6d\t%6d\t%6d\n",
-	       gpool, gallocs, gfrees);
-	fprintf(stderr, "btrans\t%6d\t%6d\t%6d\n",
-	       bpool, ballocs, bfrees);
+	stats->atrans.pool   = apool;
+	stats->atrans.allocs = aallocs;
+	stats->atrans.frees  = afrees;
+	stats->gtrans.pool   = gpool;
+	stats->gtrans.allocs = gallocs;
+	stats->gtrans.frees  = gfrees;
+	stats->btrans.pool   = bpool;
+	stats->btrans.allocs = ballocs;
+	stats->btrans.frees  = bfrees;
 }
@@ -33,29 +33,297 @@ static const enum { NONE, LEFT, RIGHT } assoc[5] = {
 	RIGHT,
 };
 
+/* Results of implies() on pairs of signed nodes. The table lives as long as
+ * the parse, but nodes are freed and reused between two calls to
+ * bin_simpler(), so each call starts a new generation and the entries of
+ * older generations count as empty slots. */
+typedef struct {
+	const Node *a, *b;
+	unsigned gen;
+	char signs, result;
+} Implied;
+
+typedef struct {
+	const Symbol *sym;
+	unsigned gen;
+} ImpliedAtom;
+
+struct ltl2ba_Implied {
+	Implied *slots;   /* open addressing */
+	int size, count;  /* size is 0 or a power of 2; count is for gen */
+	unsigned gen;
+	/* the operands of the node of bin_simpler(), and whether they share
+	 * no predicate and hold no constant, -1 until known */
+	const Node *lft, *rgt;
+	int apart;
+	ImpliedAtom *atoms;	/* the predicates of rgt, as slots */
+	int atoms_size, atoms_count;
+};
+
+static unsigned
+implied_hash(const Node *a, const Node *b, int signs)
+{
+	size_t h = ((size_t) a >> 3) * 0x9e3779b1u ^ ((size_t) b >> 3) ^ signs;
+
+	return (unsigned) (h ^ h >> 16) * 0x85ebca6bu;
+}
+
+/* the slot of (a, b, signs), or the empty slot where it goes */
+static Implied *
+implied_slot(struct ltl2ba_Implied *memo, const Node *a, const Node *b, int signs)
+{	unsigned i = implied_hash(a, b, signs) & (memo->size - 1);
+	Implied *e;
+
+	for (;; i = (i + 1) & (memo->size - 1))
+	{	e = &memo->slots[i];
+		if (e->gen != memo->gen
+		|| (e->a == a && e->b == b && e->signs == signs))
+			return e;
+	}
+}
+
+static void
+implied_grow(struct ltl2ba_Implied *memo)
+{	Implied *old = memo->slots, *e;
+	int i, size = memo->size;
+
+	memo->size = size ? 2 * size : 256;
+	memo->slots = (Implied *) calloc(memo->size, sizeof(Implied));
+	if (!memo->slots)
+		fatal("not enough memory");
+	for (i = 0; i < size; i++)
+		if (old[i].gen == memo->gen)
+		{	e = implied_slot(memo, old[i].a, old[i].b, old[i].signs);
+			*e = old[i];
+		}
+	free(old);
+}
+
+/* starts a new generation, for the operands of n */
+static void
+implied_reset(struct ltl2ba_Implied *memo, const Node *n)
+{
+	memo->count = 0;
+	memo->atoms_count = 0;
+	if (++memo->gen == 0)	/* wrapped around: clears the stamps */
+	{	if (memo->slots)
+			memset(memo->slots, 0, memo->size * sizeof(Implied));
+		if (memo->atoms)
+			memset(memo->atoms, 0, memo->atoms_size * sizeof(ImpliedAtom));
+		memo->gen = 1;
+	}
+	memo->lft = n ? n->lft : NULL;
+	memo->rgt = n ? n->rgt : NULL;
+	memo->apart = -1;
+}
+
+/* the slot of sym in the predicates of rgt, or the empty slot where it goes */
+static ImpliedAtom *
+implied_atom(struct ltl2ba_Implied *memo, const Symbol *sym)
+{	size_t h = ((size_t) sym >> 3) * 0x9e3779b1u;
+	unsigned i = (unsigned) (h ^ h >> 16) & (memo->atoms_size - 1);
+	ImpliedAtom *e;
+
+	for (;; i = (i + 1) & (memo->atoms_size - 1))
+	{	e = &memo->atoms[i];
+		if (e->gen != memo->gen || e->sym == sym)
+			return e;
+	}
+}
+
+static void
+implied_add_atom(struct ltl2ba_Implied *memo, const Symbol *sym)
+{	ImpliedAtom *old = memo->atoms, *e;
+	int i, size = memo->atoms_size;
+
+	if (2 * (memo->atoms_count + 1) > size)
+	{	memo->atoms_size = size ? 2 * size : 64;
+		memo->atoms = (ImpliedAtom *) calloc(memo->atoms_size, sizeof(ImpliedAtom));
+		if (!memo->atoms)
+			fatal("not enough memory");
+		for (i = 0; i < size; i++)
+			if (old[i].gen == memo->gen)
+				*implied_atom(memo, old[i].sym) = old[i];
+		free(old);
+	}
+	e = implied_atom(memo, sym);
+	if (e->gen != memo->gen)
+	{	e->sym = sym;
+		e->gen = memo->gen;
+		memo->atoms_count++;
+	}
+}
+
+/* Walks n and tells whether one of its leaves is a constant, or, when find
+ * is set, a predicate of rgt. Otherwise, adds its predicates to those of
+ * rgt. */
 static int
-implies(Node *a, Node *b)
+implied_atoms(struct ltl2ba_Implied *memo, const Node *n, int find)
+{	const Node *local[64], **st = local;
+	int sp = 0, size = 64, found = 0;
+
+	while (n && !found)
+	{	if (n->lft || n->rgt)
+		{	if (n->lft && n->rgt)
+				STACK_PUSH(st, sp, size, local, n->rgt);
+			n = n->lft ? n->lft : n->rgt;
+			continue;
+		}
+		if (!n->sym)
+			found = 1;
+		else if (find)
+			found = implied_atom(memo, n->sym)->gen == memo->gen;
+		else
+			implied_add_atom(memo, n->sym);
+		n = sp ? st[--sp] : NULL;
+	}
+	STACK_FREE(st, local);
+	return found;
+}
+
+/* Every implication implies() proves ends in a pair of equal subformulas, a
+ * true one or a false one. Operands that share no predicate and hold no
+ * constant therefore imply nothing of each other, and bin_simpler() only
+ * asks implies() about one subformula of each. This spares walking long
+ * operands, e.g. a growing conjunction and each new conjunct, which the
+ * memo cannot do: the pairs are new at every call. */
+static int
+implied_apart(struct ltl2ba_Implied *memo)
+{
+	if (memo->apart < 0)
+		memo->apart = memo->lft && memo->rgt
+		           && !implied_atoms(memo, memo->rgt, 0)
+		           && !implied_atoms(memo, memo->lft, 1);
+	return memo->apart;
+}
+
+/* The rules of implies(a, b) beyond a == b, b true and a false, tried in
+ * order: a rule applies when a and b have the types ta and tb (0 for any)
+ * and holds when all of its steps imply (or one of them if !all). A step
+ * compares an operand of a with an operand of b: the node itself ('='), or
+ * its left ('l') or right ('r') operand. */
+static const struct implies_rule {
+	short ta, tb;
+	char all, steps;
+	char op[2][3];	/* the operands of a and b of each step */
+} implies_rules[] = {
+	{ 0,      AND,    1, 2, { "=l", "=r" } },
+	{ OR,     0,      1, 2, { "l=", "r=" } },
+	{ AND,    0,      0, 2, { "l=", "r=" } },
+	{ 0,      OR,     0, 2, { "=l", "=r" } },
+	{ 0,      U_OPER, 1, 1, { "=r" } },
+	{ V_OPER, 0,      1, 1, { "r=" } },
+	{ U_OPER, 0,      1, 2, { "l=", "r=" } },
+	{ 0,      V_OPER, 1, 2, { "=l", "=r" } },
+	{ U_OPER, U_OPER, 1, 2, { "ll", "rr" } },
+	{ V_OPER, V_OPER, 1, 2, { "ll", "rr" } },
+};
+
+#define NR_IMPLIES_RULES	(int) (sizeof(implies_rules) / sizeof(implies_rules[0]))
+
+static void
+implied_store(struct ltl2ba_Implied *memo, const Node *a, const Node *b,
+	      int signs, int r)
+{	Implied *e;
+
+	if (2 * (memo->count + 1) > memo->size)
+		implied_grow(memo);
+	e = implied_slot(memo, a, b, signs);
+	e->a = a;
+	e->b = b;
+	e->signs = signs;
+	e->gen = memo->gen;
+	e->result = r;
+	memo->count++;
+}
+
+static const Node *
+implies_operand(const Node *n, int which)
 {
-  return
-    (isequal(a,b) ||
-     b->ntyp == TRUE ||
-     a->ntyp == FALSE ||
-     (b->ntyp == AND && implies(a, b->lft) && implies(a, b->rgt)) ||
-     (a->ntyp == OR && implies(a->lft, b) && implies(a->rgt, b)) ||
-     (a->ntyp == AND && (implies(a->lft, b) || implies(a->rgt, b))) ||
-     (b->ntyp == OR && (implies(a, b->lft) || implies(a, b->rgt))) ||
-     (b->ntyp == U_OPER && implies(a, b->rgt)) ||
-     (a->ntyp == V_OPER && implies(a->rgt, b)) ||
-     (a->ntyp == U_OPER && implies(a->lft, b) && implies(a->rgt, b)) ||
-     (b->ntyp == V_OPER && implies(a, b->lft) && implies(a, b->rgt)) ||
-     ((a->ntyp == U_OPER || a->ntyp == V_OPER) && a->ntyp == b->ntyp &&
-         implies(a->lft, b->lft) && implies(a->rgt, b->rgt)));
+	return which == 'l' ? n->lft : which == 'r' ? n->rgt : n;
+}
+
+/* whether a implies b, na and nb negating a and b (see sgn_norm()). The
+ * calls waiting for the result of a step of their rule are kept on an
+ * explicit stack, as the chains of operands can be long. */
+static int
+implies(struct ltl2ba_Implied *memo, const Node *a, int na, const Node *b, int nb)
+{	struct {
+		const Node *a, *b;
+		int na, nb, ta, tb;
+		int rule, k;	/* the step waiting for its result */
+	} local[32], *st = local, *c;
+	int sp = 0, size = 32, ta, tb, r;
+	Implied *e;
+	const struct implies_rule *p;
+
+	if (implied_apart(memo))
+		return 0;
+	for (;;)
+	{	/* calls implies(a, b) */
+		sgn_norm(&a, &na);
+		sgn_norm(&b, &nb);
+		r = -1;
+		if (memo->size)
+		{	e = implied_slot(memo, a, b, na | nb << 1);
+			if (e->gen == memo->gen)
+				r = e->result;
+		}
+		if (r < 0)
+		{	ta = sgn_ntyp(a, na);
+			tb = sgn_ntyp(b, nb);
+			if (isequal_sgn(a, na, b, nb) || tb == TRUE || ta == FALSE)
+			{	r = 1;
+				implied_store(memo, a, b, na | nb << 1, r);
+			} else
+			{	STACK_RESERVE(st, sp, size, local);
+				c = &st[sp++];
+				c->a = a, c->na = na, c->ta = ta;
+				c->b = b, c->nb = nb, c->tb = tb;
+				c->rule = 0;
+				c->k = -1;	/* no step yet */
+		}	}
+
+		/* returns r to the callers, up to the next step to call */
+		while (sp)
+		{	c = &st[sp - 1];
+			if (c->k >= 0)	/* r is the result of step k */
+			{	p = &implies_rules[c->rule];
+				if (r == p->all && ++c->k < p->steps)
+					break;
+				if (r)	/* the rule holds */
+					goto done;
+				c->rule++;
+			}
+			for (c->k = 0; c->rule < NR_IMPLIES_RULES; c->rule++)
+			{	p = &implies_rules[c->rule];
+				if ((!p->ta || p->ta == c->ta)
+				&&  (!p->tb || p->tb == c->tb))
+					break;
+			}
+			if (c->rule < NR_IMPLIES_RULES)
+				break;
+			r = 0;
+done:			implied_store(memo, c->a, c->b, c->na | c->nb << 1, r);
+			sp--;
+		}
+		if (!sp)
+			break;
+		a = implies_operand(c->a, p->op[c->k][0]);
+		b = implies_operand(c->b, p->op[c->k][1]);
+		na = c->na;
+		nb = c->nb;
+	}
+	STACK_FREE(st, local);
+	return r;
 }
 
 static Node *
-bin_simpler(Symtab symtab, Node *ptr)
+bin_simpler(Symtab symtab, struct ltl2ba_Implied *memo, Node *ptr)
 {	Node *a, *b;
 
+	implied_reset(memo, ptr);
+
 	if (ptr)
 	switch (ptr->ntyp) {
 	case U_OPER:
@@ -65,7 +333,7 @@ bin_simpler(Symtab symtab, Node *ptr)
 		{	ptr = ptr->rgt;
 			break;
 		}
-		if (implies(ptr->lft, ptr->rgt)) /* NEW */
+		if (implies(memo, ptr->lft, 0, ptr->rgt, 0)) /* NEW */
 		{	ptr = ptr->rgt;
 		        break;
 		}
@@ -76,7 +344,7 @@ bin_simpler(Symtab symtab, Node *ptr)
 			break;
 		}
 		if (ptr->rgt->ntyp == U_OPER
-		&&  implies(ptr->lft, ptr->rgt->lft))
+		&&  implies(memo, ptr->lft, 0, ptr->rgt->lft, 0))
 		{	/* NEW */
 			ptr = ptr->rgt;
 			break;
@@ -111,8 +379,7 @@ bin_simpler(Symtab symtab, Node *ptr)
 
 		/* NEW */
 		if (ptr->lft->ntyp != TRUE &&
-		    implies(push_negation(symtab, tl_nn(NOT, dupnode(ptr->rgt), NULL)),
-			    ptr->lft))
+		    implies(memo, ptr->rgt, 1, ptr->lft, 0))
 		{       ptr->lft = True;
 		        break;
 		}
@@ -124,7 +391,7 @@ bin_simpler(Symtab symtab, Node *ptr)
 		{	ptr = ptr->rgt;
 			break;
 		}
-		if (implies(ptr->rgt, ptr->lft))
+		if (implies(memo, ptr->rgt, 0, ptr->lft, 0))
 		{	/* p V p = p */
 			ptr = ptr->rgt;
 			break;
@@ -155,15 +422,14 @@ bin_simpler(Symtab symtab, Node *ptr)
 
 		/* NEW */
 		if (ptr->rgt->ntyp == V_OPER
-		&&  implies(ptr->rgt->lft, ptr->lft))
+		&&  implies(memo, ptr->rgt->lft, 0, ptr->lft, 0))
 		{	ptr = ptr->rgt;
 			break;
 		}
 
 		/* NEW */
 		if (ptr->lft->ntyp != FALSE &&
-		    implies(ptr->lft,
-			    push_negation(symtab, tl_nn(NOT, dupnode(ptr->rgt), NULL))))
+		    implies(memo, ptr->lft, 0, ptr->rgt, 1))
 		{       ptr->lft = False;
 		        break;
 		}
@@ -189,7 +455,7 @@ bin_simpler(Symtab symtab, Node *ptr)
 		break;
 
 	case IMPLIES:
-		if (implies(ptr->lft, ptr->rgt))
+		if (implies(memo, ptr->lft, 0, ptr->rgt, 0))
 		  {	ptr = True;
 			break;
 		}
@@ -197,8 +463,8 @@ bin_simpler(Symtab symtab, Node *ptr)
 		ptr = rewrite(ptr);
 		break;
 	case EQUIV:
-		if (implies(ptr->lft, ptr->rgt) &&
-		    implies(ptr->rgt, ptr->lft))
+		if (implies(memo, ptr->lft, 0, ptr->rgt, 0) &&
+		    implies(memo, ptr->rgt, 0, ptr->lft, 0))
 		  {	ptr = True;
 			break;
 		}
@@ -277,13 +543,13 @@ bin_simpler(Symtab symtab, Node *ptr)
 		if (isequal(ptr->lft, ptr->rgt)	/* (p && p) == p */
 		||  ptr->rgt->ntyp == FALSE	/* (p && F) == F */
 		||  ptr->lft->ntyp == TRUE	/* (T && p) == p */
-		||  implies(ptr->rgt, ptr->lft))/* NEW */
+		||  implies(memo, ptr->rgt, 0, ptr->lft, 0))/* NEW */
 		{	ptr = ptr->rgt;
 			break;
 		}
 		if (ptr->rgt->ntyp == TRUE	/* (p && T) == p */
 		||  ptr->lft->ntyp == FALSE	/* (F && p) == F */
-		||  implies(ptr->lft, ptr->rgt))/* NEW */
+		||  implies(memo, ptr->lft, 0, ptr->rgt, 0))/* NEW */
 		{	ptr = ptr->lft;
 			break;
 		}
@@ -306,10 +572,8 @@ bin_simpler(Symtab symtab, Node *ptr)
 		  }
 
 		/* NEW */
-		if (implies(ptr->lft,
-			    push_negation(symtab, tl_nn(NOT, dupnode(ptr->rgt), NULL)))
-		 || implies(ptr->rgt,
-			    push_negation(symtab, tl_nn(NOT, dupnode(ptr->lft), NULL))))
+		if (implies(memo, ptr->lft, 0, ptr->rgt, 1)
+		 || implies(memo, ptr->rgt, 0, ptr->lft, 1))
 		{       ptr = False;
 		        break;
 		}
@@ -343,13 +607,13 @@ bin_simpler(Symtab symtab, Node *ptr)
 		if (isequal(ptr->lft, ptr->rgt)	/* (p || p) == p */
 		||  ptr->rgt->ntyp == FALSE	/* (p || F) == p */
 		||  ptr->lft->ntyp == TRUE	/* (T || p) == T */
-		||  implies(ptr->rgt, ptr->lft))/* NEW */
+		||  implies(memo, ptr->rgt, 0, ptr->lft, 0))/* NEW */
 		{	ptr = ptr->lft;
 			break;
 		}
 		if (ptr->rgt->ntyp == TRUE	/* (p || T) == T */
 		||  ptr->lft->ntyp == FALSE	/* (F || p) == p */
-		||  implies(ptr->lft, ptr->rgt))/* NEW */
+		||  implies(memo, ptr->lft, 0, ptr->rgt, 0))/* NEW */
 		{	ptr = ptr->rgt;
 			break;
 		}
@@ -390,10 +654,8 @@ bin_simpler(Symtab symtab, Node *ptr)
 		  }
 
 		/* NEW */
-		if (implies(push_negation(symtab, tl_nn(NOT, dupnode(ptr->rgt), NULL)),
-			    ptr->lft)
-		 || implies(push_negation(symtab, tl_nn(NOT, dupnode(ptr->lft), NULL)),
-			    ptr->rgt))
+		if (implies(memo, ptr->rgt, 1, ptr->lft, 0)
+		 || implies(memo, ptr->lft, 1, ptr->rgt, 0))
 		{       ptr = True;
 		        break;
 		}
@@ -489,7 +751,7 @@ tl_factor(Symtab symtab, Cexprtab *cexpr, Lexer *lex, Flags flags)
 		ptr = tl_nn(U_OPER, True, ptr);
 	simpl:
 		if (flags & LTL2BA_SIMP_LOG)
-		  ptr = bin_simpler(symtab, ptr);
+		  ptr = bin_simpler(symtab, lex->implied, ptr);
 		break;
 	case PREDICATE:
 		ptr = lex->tl_yylval;
@@ -556,7 +818,7 @@ again:
 			head->lft = res;
 
 		if (flags & LTL2BA_SIMP_LOG)
-			head = bin_simpler(symtab, head);
+			head = bin_simpler(symtab, lex->implied, head);
 		else
 			head = bin_minimal(symtab, head);
 
@@ -580,12 +842,21 @@ static Node * tl_formula(Symtab symtab, Cexprtab *cexpr, Lexer *lex, Flags flags
 	return tl_level(symtab, cexpr, lex, flags, sizeof(prec)/sizeof(*prec)-1); /* 5 precedence levels: 4 to 0 */
 }
 
-Node * tl_parse(Symtab symtab, Cexprtab *cexpr, Flags flags)
+Node * ltl2ba_parse(const char *buf, size_t len, Symtab symtab, Cexprtab *cexpr,
+                    Flags flags)
 {
 	Lexer lex;
+	struct ltl2ba_Implied implied;
 	memset(&lex, 0, sizeof(lex));
+	memset(&implied, 0, sizeof(implied));
+	lex.buf = buf;
+	lex.len = len;
+	lex.implied = &implied;
 	Node *f = tl_formula(symtab, cexpr, &lex, flags);
 	if (lex.tl_yychar != ';')
 		tl_yyerror(&lex, "syntax error");
+	free(lex.yytext);
+	free(implied.slots);
+	free(implied.atoms);
 	return f;
 }
@@ -11,201 +11,291 @@
 
 #include "internal.h"
 
+#include <limits.h>
+
+/* Reads the prefix serialization of a formula one character at a time,
+ * operators first, then the right operand and the left one. The operands of
+ * AND and OR are sorted in the order of these serializations. */
+typedef struct {
+	const Node **stack;
+	int sp, size;
+	const char *name; /* rest of the name being read */
+} DumpIter;
+
 static void
-sdump(Node *n, char *dumpbuf)
+dump_push(DumpIter *it, const Node *n)
 {
-	switch (n->ntyp) {
-	case PREDICATE:	strcat(dumpbuf, n->sym->name);
-			break;
-	case U_OPER:	strcat(dumpbuf, "U");
-			goto common2;
-	case V_OPER:	strcat(dumpbuf, "V");
-			goto common2;
-	case OR:	strcat(dumpbuf, "|");
-			goto common2;
-	case AND:	strcat(dumpbuf, "&");
-common2:		sdump(n->rgt, dumpbuf);
-common1:		sdump(n->lft, dumpbuf);
-			break;
-	case NEXT:	strcat(dumpbuf, "X");
-			goto common1;
-	case NOT:	strcat(dumpbuf, "!");
-			goto common1;
-	case TRUE:	strcat(dumpbuf, "T");
-			break;
-	case FALSE:	strcat(dumpbuf, "F");
-			break;
-	default:	strcat(dumpbuf, "?");
-			break;
+	if (it->sp == it->size) {
+		it->size = it->size ? 2 * it->size : 64;
+		it->stack = (const Node **)realloc(it->stack, it->size * sizeof(Node *));
+		if (!it->stack)
+			fatal("not enough memory");
 	}
+	it->stack[it->sp++] = n;
 }
 
-static Symbol *
-DoDump(Symtab symtab, Node *n)
-{
-	if (!n) return NULL;
-
-	if (n->ntyp == PREDICATE)
-		return n->sym;
+static int
+dump_next(DumpIter *it)
+{	const Node *n;
+
+	for (;;) {
+		if (it->name && *it->name)
+			return (unsigned char) *it->name++;
+		if (!it->sp)
+			return -1;
+		n = it->stack[--it->sp];
+		switch (n->ntyp) {
+		case PREDICATE:	it->name = n->sym->name;
+				continue;
+		case U_OPER:	dump_push(it, n->lft);
+				dump_push(it, n->rgt);
+				return 'U';
+		case V_OPER:	dump_push(it, n->lft);
+				dump_push(it, n->rgt);
+				return 'V';
+		case OR:	dump_push(it, n->lft);
+				dump_push(it, n->rgt);
+				return '|';
+		case AND:	dump_push(it, n->lft);
+				dump_push(it, n->rgt);
+				return '&';
+		case NEXT:	dump_push(it, n->lft);
+				return 'X';
+		case NOT:	dump_push(it, n->lft);
+				return '!';
+		case TRUE:	return 'T';
+		case FALSE:	return 'F';
+		default:	return '?';
+		}
+	}
+}
 
-	char dumpbuf[2048];
-	dumpbuf[0] = '\0';
-	sdump(n, dumpbuf);
-	return tl_lookup(symtab, dumpbuf);
+/* compares the serializations of a and b, as strcmp() would */
+static int
+dump_cmp(const Node *a, const Node *b)
+{	static DumpIter ia, ib;
+	int ca, cb;
+
+	ia.sp = ib.sp = 0;
+	ia.name = ib.name = NULL;
+	dump_push(&ia, a);
+	dump_push(&ib, b);
+	do {
+		ca = dump_next(&ia);
+		cb = dump_next(&ib);
+	} while (ca == cb && ca != -1);
+	return ca - cb;
 }
 
 Node *
 right_linked(Node *n)
-{
-	if (!n) return n;
-
-	if (n->ntyp == AND || n->ntyp == OR)
-		while (n->lft && n->lft->ntyp == n->ntyp)
-		{	Node *tmp = n->lft;
-			n->lft = tmp->rgt;
-			tmp->rgt = n;
-			n = tmp;
-		}
-
-	n->lft = right_linked(n->lft);
-	n->rgt = right_linked(n->rgt);
+{	Node **local[64], ***st = local, **slot, *tmp;
+	int sp = 0, size = 64;
+
+	st[sp++] = &n;
+	while (sp)	/* the left operands first */
+	{	slot = st[--sp];
+		if (!*slot) continue;
+
+		if ((*slot)->ntyp == AND || (*slot)->ntyp == OR)
+			while ((*slot)->lft && (*slot)->lft->ntyp == (*slot)->ntyp)
+			{	tmp = (*slot)->lft;
+				(*slot)->lft = tmp->rgt;
+				tmp->rgt = *slot;
+				*slot = tmp;
+			}
 
+		STACK_PUSH(st, sp, size, local, &(*slot)->rgt);
+		STACK_PUSH(st, sp, size, local, &(*slot)->lft);
+	}
+	STACK_FREE(st, local);
 	return n;
 }
 
 Node *
 canonical(Symtab symtab, Node *n)
-{	Node *m;	/* assumes input is right_linked */
-
-	if (!n) return n;
-	if ((m = in_cache(n)))
-		return m;
-
-	n->rgt = canonical(symtab, n->rgt);
-	n->lft = canonical(symtab, n->lft);
-
-	return cached(symtab, n);
+{	struct { Node **slot; int pc; } local[64], *st = local;
+	int sp = 0, size = 64;	/* assumes input is right_linked */
+	Node *m, *c;
+
+	st[sp].slot = &n;
+	st[sp++].pc = 0;
+	while (sp)	/* the right operand, the left one, then the node */
+	{	m = *st[sp - 1].slot;
+		switch (st[sp - 1].pc++) {
+		case 0:
+			if (!m)
+				sp--;
+			else if ((c = in_cache(m)))
+				*st[--sp].slot = c;
+			else
+			{	STACK_RESERVE(st, sp, size, local);
+				st[sp].slot = &m->rgt;
+				st[sp++].pc = 0;
+			}
+			break;
+		case 1:
+			STACK_RESERVE(st, sp, size, local);
+			st[sp].slot = &m->lft;
+			st[sp++].pc = 0;
+			break;
+		default:
+			*st[--sp].slot = cached(symtab, m);
+			break;
+	}	}
+	STACK_FREE(st, local);
+	return n;
 }
 
 Node *
 push_negation(Symtab symtab, Node *n)
-{	Node *m;
-
-	Assert(n->ntyp == NOT, n->ntyp);
-
-	switch (n->lft->ntyp) {
-	case TRUE:
-		releasenode(0, n->lft);
-		n->lft = NULL;
-		n->ntyp = FALSE;
-		break;
-	case FALSE:
-		releasenode(0, n->lft);
-		n->lft = NULL;
-		n->ntyp = TRUE;
-		break;
-	case NOT:
-		m = n->lft->lft;
-		releasenode(0, n->lft);
-		n->lft = NULL;
-		releasenode(0, n);
-		n = m;
-		break;
-	case V_OPER:
-		n->ntyp = U_OPER;
-		goto same;
-	case U_OPER:
-		n->ntyp = V_OPER;
-		goto same;
-	case NEXT:
-		n->ntyp = NEXT;
-		n->lft->ntyp = NOT;
-		n->lft = push_negation(symtab, n->lft);
-		break;
-	case  AND:
-		n->ntyp = OR;
-		goto same;
-	case  OR:
-		n->ntyp = AND;
-
-same:		m = n->lft->rgt;
-		n->lft->rgt = NULL;
-
-		n->rgt = Not(m);
-		n->lft->ntyp = NOT;
-		m = n->lft;
-		n->lft = push_negation(symtab, m);
-		break;
-	}
+{	struct { Node *n; int pc; } local[32], *st = local;
+	int sp = 0, size = 32;
+	Node *m;
+
+	for (;;)	/* the operands wait on st for the negations they push */
+	{	Assert(n->ntyp == NOT, n->ntyp);
+
+		switch (n->lft->ntyp) {
+		case TRUE:
+			releasenode(0, n->lft);
+			n->lft = NULL;
+			n->ntyp = FALSE;
+			break;
+		case FALSE:
+			releasenode(0, n->lft);
+			n->lft = NULL;
+			n->ntyp = TRUE;
+			break;
+		case NOT:
+			m = n->lft->lft;
+			releasenode(0, n->lft);
+			n->lft = NULL;
+			releasenode(0, n);
+			n = m;
+			break;
+		case V_OPER:
+			n->ntyp = U_OPER;
+			goto same;
+		case U_OPER:
+			n->ntyp = V_OPER;
+			goto same;
+		case NEXT:
+			n->ntyp = NEXT;
+			n->lft->ntyp = NOT;
+			STACK_RESERVE(st, sp, size, local);
+			st[sp].n = n;
+			st[sp++].pc = 2;	/* pushes the negation in n->lft */
+			n = n->lft;
+			continue;
+		case  AND:
+			n->ntyp = OR;
+			goto same;
+		case  OR:
+			n->ntyp = AND;
+
+same:			m = n->lft->rgt;
+			n->lft->rgt = NULL;
+
+			STACK_RESERVE(st, sp, size, local);
+			st[sp].n = n;
+			st[sp++].pc = 1;	/* pushes Not(m) in n->rgt */
+			n = tl_nn(NOT, m, NULL);
+			continue;
+		}
 
-	return rewrite(n);
+		n = rewrite(n);
+		while (sp && st[sp - 1].pc == 2)
+		{	m = st[--sp].n;
+			m->lft = n;
+			n = rewrite(m);
+		}
+		if (!sp)
+			return n;
+		m = st[sp - 1].n;
+		m->rgt = n;
+		m->lft->ntyp = NOT;
+		st[sp - 1].pc = 2;
+		n = m->lft;
+	}
 }
 
-static void addcan(Symtab symtab, int tok, Node *n, Node **pcan)
-{
-	Node	*m, *prev = NULL;
-	Node	**ptr;
-	Node	*N;
-	Symbol	*s, *t; int cmp;
+/* the operands of an AND or OR, in the order they are found */
+typedef struct {
+	Node **op;
+	int count, size;
+} Operands;
 
-	if (!n) return;
-
-	if (n->ntyp == tok)
-	{
-		addcan(symtab, tok, n->rgt, pcan);
-		addcan(symtab, tok, n->lft, pcan);
-		return;
-	}
-#if 0
-	if ((tok == AND && n->ntyp == TRUE)
-	||  (tok == OR  && n->ntyp == FALSE))
-		return;
-#endif
-	N = dupnode(n);
-	if (!*pcan)
-	{
-		*pcan = N;
-		return;
+static void
+collect_operands(int tok, Node *n, Operands *ops)
+{	Node *local[64], **st = local;
+	int sp = 0, size = 64;
+
+	st[sp++] = n;
+	while (sp)	/* the right operands first */
+	{	n = st[--sp];
+		if (!n) continue;
+
+		if (n->ntyp == tok)
+		{	STACK_PUSH(st, sp, size, local, n->lft);
+			STACK_PUSH(st, sp, size, local, n->rgt);
+			continue;
+		}
+		if (ops->count == ops->size) {
+			ops->size = ops->size ? 2 * ops->size : 16;
+			ops->op = (Node **)realloc(ops->op, ops->size * sizeof(Node *));
+			if (!ops->op)
+				fatal("not enough memory");
+		}
+		ops->op[ops->count++] = n;
 	}
+	STACK_FREE(st, local);
+}
 
-	s = DoDump(symtab, N);
-	if ((*pcan)->ntyp != tok)	/* only one element in list so far */
-	{
-		ptr = pcan;
-		goto insert;
-	}
+/* stable merge sort of op[0 .. count-1] by serialization */
+static void
+sort_operands(Node **op, Node **tmp, int count)
+{	int i, j, k, mid = count / 2;
 
-	/* there are at least 2 elements in list */
-	prev = NULL;
-	for (m = *pcan; m->ntyp == tok && m->rgt; prev = m, m = m->rgt)
-	{
-		t = DoDump(symtab, m->lft);
-		cmp = strcmp(s->name, t->name);
-		if (cmp == 0)	/* duplicate */
-			return;
-		if (cmp < 0)
-		{
-			if (!prev)
-			{
-				*pcan = tl_nn(tok, N, *pcan);
-				return;
-			} else
-			{
-				ptr = &(prev->rgt);
-				goto insert;
-	}	}	}
-
-	/* new entry goes at the end of the list */
-	ptr = &(prev->rgt);
-insert:
-	t = DoDump(symtab, *ptr);
-	cmp = strcmp(s->name, t->name);
-	if (cmp == 0)	/* duplicate */
+	if (count < 2)
 		return;
-	if (cmp < 0)
-		*ptr = tl_nn(tok, N, *ptr);
-	else
-		*ptr = tl_nn(tok, *ptr, N);
+	sort_operands(op, tmp, mid);
+	sort_operands(op + mid, tmp, count - mid);
+	for (i = 0, j = mid, k = 0; i < mid && j < count; )
+		tmp[k++] = dump_cmp(op[j], op[i]) < 0 ? op[j++] : op[i++];
+	while (i < mid)
+		tmp[k++] = op[i++];
+	memcpy(op, tmp, k * sizeof(Node *));
+}
+
+/* returns the right-linked list of the operands of n, sorted and without
+ * duplicates, the first one found being kept */
+static Node *
+addcan(int tok, Node *n)
+{
+	Operands ops = { NULL, 0, 0 };
+	Node **tmp, *can = NULL;
+	int i, k;
+
+	collect_operands(tok, n, &ops);
+	if (!ops.count)
+		return NULL;
+
+	tmp = (Node **)malloc(ops.count * sizeof(Node *));
+	if (!tmp)
+		fatal("not enough memory");
+	sort_operands(ops.op, tmp, ops.count);
+	for (i = k = 0; i < ops.count; i++)
+		if (!k || dump_cmp(ops.op[i], ops.op[k - 1]) != 0)
+			ops.op[k++] = ops.op[i];
+
+	can = dupnode(ops.op[--k]);
+	while (k > 0)
+		can = tl_nn(tok, dupnode(ops.op[--k]), can);
+
+	free(tmp);
+	free(ops.op);
+	return can;
 }
 
 static void
@@ -218,40 +308,83 @@ marknode(int tok, Node *m)
 	m->ntyp = -1;
 }
 
-static int
-any_term(Node *srch, Node *in)
+/* Goes through the terms of a formula: the formula itself or, if it is a
+ * tok, the terms of its operands, the left ones first. */
+typedef struct {
+	const Node *local[64], **st;
+	int sp, size, tok;
+} Terms;
+
+static void
+terms_init(Terms *it, int tok, const Node *n)
 {
-	if (!in) return 0;
+	it->st = it->local;
+	it->size = 64;
+	it->tok = tok;
+	it->sp = 0;
+	it->st[it->sp++] = n;
+}
 
-	if (in->ntyp == AND)
-		return	any_term(srch, in->lft) ||
-			any_term(srch, in->rgt);
+static const Node *
+terms_next(Terms *it)
+{	const Node *n;
+
+	while (it->sp)
+	{	n = it->st[--it->sp];
+		if (!n) continue;
+		if (n->ntyp != it->tok)
+			return n;
+		STACK_PUSH(it->st, it->sp, it->size, it->local, n->rgt);
+		STACK_PUSH(it->st, it->sp, it->size, it->local, n->lft);
+	}
+	return NULL;
+}
 
-	return isequal(in, srch);
+static void
+terms_free(Terms *it)
+{
+	STACK_FREE(it->st, it->local);
+}
+
+static int
+any_term(Node *srch, Node *in)
+{	Terms it;
+	const Node *n;
+	int r = 0;
+
+	terms_init(&it, AND, in);
+	while (!r && (n = terms_next(&it)))
+		r = isequal(n, srch);
+	terms_free(&it);
+	return r;
 }
 
 static int
 any_and(Node *srch, Node *in)
-{
-	if (!in) return 0;
+{	Terms it;
+	const Node *n;
+	int r = 1;
 
-	if (srch->ntyp == AND)
-		return	any_and(srch->lft, in) &&
-			any_and(srch->rgt, in);
+	if (!in) return 0;
 
-	return any_term(srch, in);
+	terms_init(&it, AND, srch);
+	while (r && (n = terms_next(&it)))
+		r = any_term((Node *) n, in);
+	terms_free(&it);
+	return r;
 }
 
 static int
 any_lor(Node *srch, Node *in)
-{
-	if (!in) return 0;
-
-	if (in->ntyp == OR)
-		return	any_lor(srch, in->lft) ||
-			any_lor(srch, in->rgt);
-
-	return isequal(in, srch);
+{	Terms it;
+	const Node *n;
+	int r = 0;
+
+	terms_init(&it, OR, in);
+	while (!r && (n = terms_next(&it)))
+		r = isequal(n, srch);
+	terms_free(&it);
+	return r;
 }
 
 static int
@@ -268,9 +401,284 @@ anywhere(int tok, Node *srch, Node *in)
 	return 0;
 }
 
+/* A hash of the formulas, such that isequal(a, b) implies equal hashes: the
+ * operands of AND and OR, which isequal() compares as sets, only count
+ * through the smallest and the largest of their hashes. */
+#define HASH_MIX(h, x)	(((h) ^ (unsigned) (x)) * 0x9e3779b1u)
+
+static unsigned
+node_hash(const Node *n)
+{	struct {
+		const Node *n;
+		int up;		/* the frame the hash goes to */
+		int pc;		/* -1 until n is reached */
+		unsigned h, lo, hi;
+	} local[32], *st = local;
+	int sp = 0, size = 32, t, up;
+	unsigned h = 0;
+
+#define Hash(x, u)	{ STACK_RESERVE(st, sp, size, local);	\
+			  st[sp].n = (x);			\
+			  st[sp].up = (u);			\
+			  st[sp++].pc = -1; }
+	Hash(n, -1);
+	while (sp)
+	{	t = sp - 1;
+		n = st[t].n;
+		if (st[t].pc < 0)
+		{	up = st[t].up;
+			if (up >= 0 && n->ntyp == st[up].n->ntyp
+			&&  (n->ntyp == AND || n->ntyp == OR))
+			{	/* its operands are those of st[up] */
+				st[t].n = n->rgt;
+				Hash(n->lft, up);
+				continue;
+			}
+			st[t].pc = 0;
+			st[t].h = HASH_MIX(0, n->ntyp);
+			st[t].lo = ~0u;
+			st[t].hi = 0;
+		}
+		switch (n->ntyp) {
+		case PREDICATE:
+			h = HASH_MIX(st[t].h, (size_t) n->sym >> 3);
+			break;
+		case NOT:
+		case NEXT:
+			if (!st[t].pc++)
+			{	Hash(n->lft, t);
+				continue;
+			}
+			h = st[t].h;
+			break;
+		case U_OPER:
+		case V_OPER:
+			if (st[t].pc < 2)
+			{	Hash(st[t].pc++ ? n->rgt : n->lft, t);
+				continue;
+			}
+			h = st[t].h;
+			break;
+		case AND:
+		case OR:
+			if (!st[t].pc++)
+			{	Hash(n->rgt, t);
+				Hash(n->lft, t);
+				continue;
+			}
+			h = HASH_MIX(HASH_MIX(st[t].h, st[t].lo), st[t].hi);
+			break;
+		default:
+			h = st[t].h;
+			break;
+		}
+
+		/* h is the hash of n, that goes to st[up] */
+		up = st[--sp].up;
+		if (up < 0)
+			break;
+		if (st[up].n->ntyp == AND || st[up].n->ntyp == OR)
+		{	if (h < st[up].lo) st[up].lo = h;
+			if (h > st[up].hi) st[up].hi = h;
+		} else
+			st[up].h = HASH_MIX(st[up].h, h);
+	}
+#undef Hash
+	STACK_FREE(st, local);
+	return h;
+}
+
+/* (hash, position) pairs sorted, to find the operands by hash */
+typedef struct {
+	unsigned hash;
+	int pos;
+} HashPos;
+
+typedef struct {
+	HashPos *v;
+	int count, size;
+} HashIndex;
+
+static void
+index_add(HashIndex *x, unsigned hash, int pos)
+{
+	if (x->count == x->size) {
+		x->size = x->size ? 2 * x->size : 64;
+		x->v = (HashPos *)realloc(x->v, x->size * sizeof(HashPos));
+		if (!x->v)
+			fatal("not enough memory");
+	}
+	x->v[x->count].hash = hash;
+	x->v[x->count++].pos = pos;
+}
+
+static int
+hashpos_cmp(const void *a, const void *b)
+{	const HashPos *x = (const HashPos *) a, *y = (const HashPos *) b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	return x->pos - y->pos;
+}
+
+/* returns the first entry with this hash, or x->count */
+static int
+index_find(const HashIndex *x, unsigned hash)
+{	int lo = 0, hi = x->count, mid;
+
+	while (lo < hi)
+	{	mid = (lo + hi) / 2;
+		if (x->v[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* indexes the terms of n, as any_term() and any_lor() go through them */
+static void
+index_terms(int tok, const Node *n, int pos, HashIndex *x)
+{	Terms it;
+
+	terms_init(&it, tok, n);
+	while ((n = terms_next(&it)))
+		index_add(x, node_hash(n), pos);
+	terms_free(&it);
+}
+
+/* the position of the first operand equal to c, or INT_MAX */
+static int
+first_equal(const HashIndex *ops, Node **elem, const Node *c)
+{	unsigned h = node_hash(c);
+	int i;
+
+	for (i = index_find(ops, h); i < ops->count && ops->v[i].hash == h; i++)
+		if (isequal(elem[ops->v[i].pos], c))
+			return ops->v[i].pos;
+	return INT_MAX;
+}
+
+/* the least lim such that all the conjuncts of srch are among the operands
+ * before position lim, minus one */
+static int
+conjuncts_within(const HashIndex *ops, Node **elem, const Node *srch)
+{	Terms it;
+	int lim = -1, p;
+
+	terms_init(&it, AND, srch);
+	while ((srch = terms_next(&it)))
+		if ((p = first_equal(ops, elem, srch)) > lim)
+			lim = p;
+	terms_free(&it);
+	return lim;
+}
+
+/* Marks the operands of the list can that another operand makes redundant.
+ * For each operand m in turn, up to the first marked one, the first operand
+ * p before the first marked one such that
+ *	AND: m == p, or p == (m || r), or p == (r U q) with all the conjuncts of
+ *	     q before the first marked operand,	q && (p U q) = q
+ *	OR:  m == p, or p == (m && r), or p == (F V q) with
+ *	     anywhere(AND, q, can),			p || (F V p) = p
+ * is marked, as a pairwise scan of the list would mark them. Rather than
+ * comparing m to every p, the candidates for p are found by hash among the
+ * operands, the terms of the operands, and for AND the right operands of
+ * U whose conjuncts are located once. */
+static void
+mark_redundant(int tok, Node *can)
+{	int op = (tok == AND) ? OR : AND;
+	Node **node, **elem, *n, *k1, *k2;
+	HashIndex ops = { NULL, 0, 0 }, terms = { NULL, 0, 0 };
+	int *ulist, *need, nu = 0, k = 0, lim, m, p, i, j, u, r;
+	unsigned h1, h2;
+
+	for (n = can; n; n = (n->ntyp == tok || (n->ntyp == -1 && n->rgt)) ? n->rgt : NULL)
+		k++;
+	node = (Node **)malloc(2 * k * sizeof(Node *));
+	ulist = (int *)malloc(2 * k * sizeof(int));
+	if (!node || !ulist)
+		fatal("not enough memory");
+	elem = node + k;
+	need = ulist + k;
+
+	lim = k;	/* the position of the first marked operand */
+	for (n = can, m = 0; m < k; n = n->rgt, m++)
+	{	node[m] = n;
+		elem[m] = (n->ntyp == tok || (n->ntyp == -1 && n->rgt)) ? n->lft : n;
+		if (n->ntyp == -1 && lim == k)
+			lim = m;
+	}
+	for (m = 0; m < lim; m++)
+	{	index_add(&ops, node_hash(elem[m]), m);
+		index_terms(op, elem[m], m, &terms);
+	}
+	if (lim)
+	{	qsort(ops.v, ops.count, sizeof(HashPos), hashpos_cmp);
+		qsort(terms.v, terms.count, sizeof(HashPos), hashpos_cmp);
+	}
+	for (m = 0; m < lim; m++)
+	{	k2 = elem[m];
+		if (tok == AND && k2->ntyp == U_OPER)
+		{	ulist[nu] = m;
+			need[nu++] = conjuncts_within(&ops, elem, k2->rgt);
+		}
+		if (tok == OR && k2->ntyp == V_OPER && k2->lft->ntyp == FALSE)
+			ulist[nu++] = m;
+	}
+
+	for (m = 0; m < k && node[m]->ntyp != -1; m++)
+	{	k1 = elem[m];
+		h1 = node_hash(k1);
+		for (n = k1; tok == OR && n->ntyp == AND; n = n->lft)
+			;
+		h2 = (tok == OR) ? node_hash(n) : h1;
+
+		/* merges the candidates by position */
+		i = index_find(&ops, h1);
+		j = index_find(&terms, h2);
+		u = 0;
+		for (;;)
+		{	p = lim;
+			if (i < ops.count && ops.v[i].hash == h1 && ops.v[i].pos < p)
+				p = ops.v[i].pos;
+			if (j < terms.count && terms.v[j].hash == h2 && terms.v[j].pos < p)
+				p = terms.v[j].pos;
+			if (u < nu && ulist[u] < p)
+				p = ulist[u];
+			if (p >= lim)
+				break;
+			while (i < ops.count && ops.v[i].hash == h1 && ops.v[i].pos <= p)
+				i++;
+			while (j < terms.count && terms.v[j].hash == h2 && terms.v[j].pos <= p)
+				j++;
+			while (u < nu && ulist[u] < p)
+				u++;
+			r = (u < nu && ulist[u] == p) ? u++ : -1;
+			if (p == m)
+				continue;
+			k2 = elem[p];
+			if (isequal(k1, k2)
+			||  anywhere(op, k1, k2)
+			||  (r >= 0
+			&&   (tok == AND ? need[r] < lim : anywhere(AND, k2->rgt, can))))
+			{	marknode(tok, node[p]);
+				lim = p;
+				break;
+		}	}
+		if (node[m]->ntyp != tok)
+			break;
+	}
+
+	free(ops.v);
+	free(terms.v);
+	free(node);
+	free(ulist);
+}
+
 Node * Canonical(Symtab symtab, Node *n)
 {
-	Node *m, *p, *k1, *k2, *prev, *dflt = NULL;
+	Node *m, *k1, *k2, *prev, *dflt = NULL;
 	int tok;
 
 	if (!n) return NULL;
@@ -279,8 +687,7 @@ Node * Canonical(Symtab symtab, Node *n)
 	if (tok != AND && tok != OR)
 		return n;
 
-	Node *can = NULL;
-	addcan(symtab, tok, n, &can);
+	Node *can = addcan(tok, n);
 #if 1
 	Debug("\nA0: "); Dump(can);
 	Debug("\nA1: "); Dump(n); Debug("\n");
@@ -301,29 +708,8 @@ Node * Canonical(Symtab symtab, Node *n)
 				can = False;
 				goto out;
 		}	}
-		for (m = can; m; m = (m->ntyp == AND) ? m->rgt : NULL)
-		for (p = can; p; p = (p->ntyp == AND) ? p->rgt : NULL)
-		{	if (p == m
-			||  p->ntyp == -1
-			||  m->ntyp == -1)
-				continue;
-			k1 = (m->ntyp == AND) ? m->lft : m;
-			k2 = (p->ntyp == AND) ? p->lft : p;
-
-			if (isequal(k1, k2))
-			{	marknode(AND, p);
-				continue;
-			}
-			if (anywhere(OR, k1, k2))
-			{	marknode(AND, p);
-				continue;
-			}
-			if (k2->ntyp == U_OPER
-			&&  anywhere(AND, k2->rgt, can))
-			{	marknode(AND, p);
-				continue;
-			}	/* q && (p U q) = q */
-	}	}
+		mark_redundant(AND, can);
+	}
 	if (tok == OR)
 	{	for (m = can; m; m = (m->ntyp == OR) ? m->rgt : NULL)
 		{	k1 = (m->ntyp == OR) ? m->lft : m;
@@ -337,30 +723,8 @@ Node * Canonical(Symtab symtab, Node *n)
 				can = True;
 				goto out;
 		}	}
-		for (m = can; m; m = (m->ntyp == OR) ? m->rgt : NULL)
-		for (p = can; p; p = (p->ntyp == OR) ? p->rgt : NULL)
-		{	if (p == m
-			||  p->ntyp == -1
-			||  m->ntyp == -1)
-				continue;
-			k1 = (m->ntyp == OR) ? m->lft : m;
-			k2 = (p->ntyp == OR) ? p->lft : p;
-
-			if (isequal(k1, k2))
-			{	marknode(OR, p);
-				continue;
-			}
-			if (anywhere(AND, k1, k2))
-			{	marknode(OR, p);
-				continue;
-			}
-			if (k2->ntyp == V_OPER
-			&&  k2->lft->ntyp == FALSE
-			&&  anywhere(AND, k2->rgt, can))
-			{	marknode(OR, p);
-				continue;
-			}	/* p || (F V p) = p */
-	}	}
+		mark_redundant(OR, can);
+	}
 	for (m = can, prev = NULL; m; )	/* remove marked nodes */
 	{	if (m->ntyp == -1)
 		{	k2 = m->rgt;
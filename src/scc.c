@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0+
+/***** ltl2ba : scc.c *****/
+
+#include "internal.h"
+
+#undef min
+#define min(x,y)        ((x<y)?x:y)
+
+/********************************************************************\
+|*              Strongly connected components (Tarjan)              *|
+\********************************************************************/
+
+void scc_work_init(SccWork *w, int n)
+{
+  w->cap      = n;
+  w->index    = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->low      = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->stack    = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->call_v   = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->call_e   = (int *)tl_emalloc((n + 1) * sizeof(int));
+  w->on_stack = (char *)tl_emalloc(n + 1);
+}
+
+void scc_work_free(SccWork *w)
+{
+  tfree(w->index);
+  tfree(w->low);
+  tfree(w->stack);
+  tfree(w->call_v);
+  tfree(w->call_e);
+  tfree(w->on_stack);
+}
+
+/* Computes the strongly connected components of the graph with n vertices
+ * whose successors of v are succ[off[v]] .. succ[off[v+1]-1], exploring
+ * depth-first from roots[0..nroots-1] in this order and the edges of each
+ * vertex in the order given. scc[v] receives the number of the component of
+ * v, components being numbered from 0 in the order they are completed (that
+ * is, in reverse topological order), or -1 if v is not reachable from the
+ * roots. Returns the number of components. Does not allocate. */
+int scc_tarjan(SccWork *w, int n, const int *off, const int *succ,
+               const int *roots, int nroots, int *scc)
+{
+  int i, v, u, rank = 0, sp = 0, cp, nscc = 0;
+
+  assert(n <= w->cap);
+  for(v = 0; v < n; v++) {
+    w->index[v] = 0; /* unvisited */
+    w->on_stack[v] = 0;
+    scc[v] = -1;
+  }
+
+  for(i = 0; i < nroots; i++) {
+    if(w->index[roots[i]])
+      continue;
+    v = roots[i];
+    w->index[v] = w->low[v] = ++rank;
+    w->stack[sp++] = v;
+    w->on_stack[v] = 1;
+    w->call_v[0] = v;
+    w->call_e[0] = off[v];
+    cp = 1;
+    while(cp) {
+      v = w->call_v[cp - 1];
+      if(w->call_e[cp - 1] < off[v + 1]) { /* explores the next edge */
+        u = succ[w->call_e[cp - 1]++];
+        if(!w->index[u]) {
+          w->index[u] = w->low[u] = ++rank;
+          w->stack[sp++] = u;
+          w->on_stack[u] = 1;
+          w->call_v[cp] = u;
+          w->call_e[cp] = off[u];
+          cp++;
+        }
+        else if(w->on_stack[u])
+          w->low[v] = min(w->low[v], w->index[u]);
+        continue;
+      }
+      if(w->low[v] == w->index[v]) { /* v is the root of a component */
+        do {
+          u = w->stack[--sp];
+          w->on_stack[u] = 0;
+          scc[u] = nscc;
+        } while(u != v);
+        nscc++;
+      }
+      if(--cp)
+        w->low[w->call_v[cp - 1]] = min(w->low[w->call_v[cp - 1]], w->low[v]);
+    }
+  }
+  return nscc;
+}
@@ -81,125 +81,123 @@ void rem_set(int *l, int n) /* removes an element from a set */
   l[n/mod] &= (-1 - (1 << (n%mod)));
 }
 
+/* prints a symbol, a C expression as {expr} */
+void print_sym_name(Writer *f, const Symbol *s, const Cexprtab *cexpr)
+{
+  if(s->kind == LTL2BA_SYM_CEXPR)
+    w_printf(f, "{%s}", cexpr->cexpr_expr_table[s->cexpr]);
+  else
+    w_printf(f, "%s", s->name);
+}
+
 /* prints the content of a set for spin */
-void spin_print_set(FILE *f, const char *const *sym_table, int *pos, int *neg, int sym_size)
+void spin_print_set(Writer *f, const Symbol *const *sym_table, int *pos, int *neg, int sym_size)
 {
   int i, j, start = 1;
   for(i = 0; i < sym_size; i++)
     for(j = 0; j < mod; j++) {
       if(pos && pos[i] & (1 << j)) {
 	if(!start)
-	  fprintf(f, " && ");
-	fprintf(f, "%s", sym_table[mod * i + j]);
+	  w_printf(f, " && ");
+	w_printf(f, "%s", sym_table[mod * i + j]->name);
 	start = 0;
       }
       if(neg && neg[i] & (1 << j)) {
 	if(!start)
-	  fprintf(f, " && ");
-	fprintf(f, "!%s", sym_table[mod * i + j]);
+	  w_printf(f, " && ");
+	w_printf(f, "!%s", sym_table[mod * i + j]->name);
 	start = 0;
       }
     }
   if(start)
-    fprintf(f, "1");
+    w_printf(f, "1");
 }
 
 /* prints the content of a set for dot */
-void dot_print_set(FILE *f, const char *const *sym_table,
+void dot_print_set(Writer *f, const Symbol *const *sym_table,
                    const Cexprtab *cexpr, int *pos, int *neg, int sym_size,
                    int need_parens)
 {
   int i, j, start = 1;
-  int count = 0, cex;
+  int count = 0;
   for(i = 0; i < sym_size; i++)
     for(j = 0; j < mod; j++) {
 	  if(pos[i] & (1 << j)) count++;
 	  if(neg[i] & (1 << j)) count++;
   }
-  if (count>1 && need_parens) fprintf(f,"(");
+  if (count>1 && need_parens) w_printf(f,"(");
   for(i = 0; i < sym_size; i++)
     for(j = 0; j < mod; j++) {
       if(pos[i] & (1 << j)) {
 	if(!start)
-	  fprintf(f, "&&");
-	if (sscanf(sym_table[mod * i + j],"_ltl2ba_cexpr_%d_status",&cex)==1)
-	/* Yes, scanning for a match here is horrid DAN */
-	  fprintf(f, "{%s}", cexpr->cexpr_expr_table[cex]);
-	else
-	  fprintf(f, "%s", sym_table[mod * i + j]);
+	  w_printf(f, "&&");
+	print_sym_name(f, sym_table[mod * i + j], cexpr);
 	start = 0;
       }
       if(neg[i] & (1 << j)) {
 	if(!start)
-	  fprintf(f, "&&");
-	if (sscanf(sym_table[mod * i + j],"_ltl2ba_cexpr_%d_status",&cex)==1)
-	/* And it's horrid here too DAN */
-	fprintf(f, "!{%s}", cexpr->cexpr_expr_table[cex]);
-	else
-      fprintf(f, "!%s", sym_table[mod * i + j]);
+	  w_printf(f, "&&");
+	w_printf(f, "!");
+	print_sym_name(f, sym_table[mod * i + j], cexpr);
 	start = 0;
       }
     }
   if(start)
-    fprintf(f, "true");
-  if (count>1 && need_parens) fprintf(f,")");
+    w_printf(f, "true");
+  if (count>1 && need_parens) w_printf(f,")");
 }
 
 /* prints the content of a set for C */
-void c_print_set(FILE *f, const char *const *sym_table, int *pos, int *neg, int sym_size)
+void c_print_set(Writer *f, const Symbol *const *sym_table, int *pos, int *neg, int sym_size)
 {
   int i, j, start = 1;
   for(i = 0; i < sym_size; i++)
     for(j = 0; j < mod; j++) {
       if(pos && pos[i] & (1 << j)) {
 	if(!start)
-	  fprintf(f, " && ");
-	fprintf(f, "%s()", sym_table[mod * i + j]);
+	  w_printf(f, " && ");
+	w_printf(f, "%s()", sym_table[mod * i + j]->name);
 	start = 0;
       }
       if(neg && neg[i] & (1 << j)) {
 	if(!start)
-	  fprintf(f, " && ");
-	fprintf(f, "!%s()", sym_table[mod * i + j]);
+	  w_printf(f, " && ");
+	w_printf(f, "!%s()", sym_table[mod * i + j]->name);
 	start = 0;
       }
     }
   if(start)
-    fprintf(f, "1");
+    w_printf(f, "1");
 }
 
-void print_set(FILE *f, int *l, int size) /* prints the content of a set */
+void print_set(Writer *f, int *l, int size) /* prints the content of a set */
 {
   int i, j, start = 1;;
-  fprintf(f, "{");
+  w_printf(f, "{");
   for(i = 0; i < size; i++)
     for(j = 0; j < mod; j++)
       if(l[i] & (1 << j)) {
-        if(!start) fprintf(f, ",");
-        fprintf(f, "%i", mod * i + j);
+        if(!start) w_printf(f, ",");
+        w_printf(f, "%i", mod * i + j);
         start = 0;
       }
-  fprintf(f, "}");
+  w_printf(f, "}");
 }
 
 /* prints the content of a symbol set */
-void print_sym_set(FILE *f, const char *const *sym_table,
+void print_sym_set(Writer *f, const Symbol *const *sym_table,
                    const Cexprtab *cexpr, int *l, int size)
 {
-  int i, j, cex, start = 1;;
-  fprintf(f, "{");
+  int i, j, start = 1;;
+  w_printf(f, "{");
   for(i = 0; i < size; i++)
     for(j = 0; j < mod; j++)
       if(l[i] & (1 << j)) {
-        if(!start) fprintf(f, " & ");
-        if (sscanf(sym_table[mod * i + j],"_ltl2ba_cexpr_%d_status",&cex)==1)
-        /* Yes, scanning for a match here is horrid DAN */
-          fprintf(f, "{%s}", cexpr->cexpr_expr_table[cex]);
-        else
-          fprintf(f, "%s", sym_table[mod * i + j]);
+        if(!start) w_printf(f, " & ");
+        print_sym_name(f, sym_table[mod * i + j], cexpr);
         start = 0;
       }
-  fprintf(f, "}");
+  w_printf(f, "}");
 }
 
 
@@ -227,6 +225,15 @@ int included_set(int *l1, int *l2, int size)
   return !test;
 }
 
+unsigned hash_set(int *l, int size) /* hashes the content of a set */
+{
+  int i;
+  unsigned h = 0;
+  for(i = 0; i < size; i++)
+    h = h * 31 + (unsigned)l[i];
+  return h;
+}
+
 int in_set(int *l, int n) /* tests if an element is in a set */
 {
   return(l[n/mod] & (1 << (n%mod)));
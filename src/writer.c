@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0+
+/***** ltl2ba : writer.c *****/
+
+#include "internal.h"
+
+#include <stdarg.h>
+
+#define WRITER_CHUNK 8192
+
+/********************************************************************\
+|*                     Buffered output sinks                        *|
+\********************************************************************/
+
+static void writer_init(Writer *w)
+{
+  memset(w, 0, sizeof(*w));
+}
+
+void ltl2ba_writer_buffer(Writer *w) /* keeps the whole output in w->buf */
+{
+  writer_init(w);
+}
+
+void ltl2ba_writer_file(Writer *w, FILE *f) /* writes to f */
+{
+  writer_init(w);
+  w->file = f;
+}
+
+void ltl2ba_writer_callback(Writer *w,
+                            void (*write)(void *ctx, const char *data,
+                                          size_t len),
+                            void *ctx) /* hands the output to write() */
+{
+  writer_init(w);
+  w->write = write;
+  w->ctx = ctx;
+}
+
+/* passes the buffered output to the sink, if any */
+void ltl2ba_writer_flush(Writer *w)
+{
+  if(!w->len || !(w->file || w->write))
+    return;
+  if(w->file)
+    fwrite(w->buf, 1, w->len, w->file);
+  else
+    w->write(w->ctx, w->buf, w->len);
+  w->len = 0;
+}
+
+void ltl2ba_writer_free(Writer *w)
+{
+  ltl2ba_writer_flush(w);
+  free(w->buf);
+  writer_init(w);
+}
+
+/* makes room for n more bytes and the terminating null byte */
+static void writer_reserve(Writer *w, size_t n)
+{
+  size_t cap;
+  char *buf;
+
+  if(w->len + n < w->cap)
+    return;
+  if(w->file || w->write) {
+    ltl2ba_writer_flush(w);
+    if(n < w->cap)
+      return;
+  }
+  cap = w->cap ? w->cap : WRITER_CHUNK;
+  while(cap <= w->len + n)
+    cap *= 2;
+  buf = (char *)realloc(w->buf, cap);
+  if(!buf)
+    fatal("not enough memory\n");
+  w->buf = buf;
+  w->cap = cap;
+}
+
+void ltl2ba_writer_write(Writer *w, const char *data, size_t len)
+{
+  writer_reserve(w, len);
+  memcpy(w->buf + w->len, data, len);
+  w->len += len;
+  w->buf[w->len] = '\0';
+}
+
+void ltl2ba_writer_puts(Writer *w, const char *s)
+{
+  ltl2ba_writer_write(w, s, strlen(s));
+}
+
+int ltl2ba_writer_printf(Writer *w, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  writer_reserve(w, 0);
+  va_start(ap, fmt);
+  n = vsnprintf(w->buf + w->len, w->cap - w->len, fmt, ap);
+  va_end(ap);
+  if(n < 0)
+    return n;
+  if((size_t)n >= w->cap - w->len) { /* did not fit: formats it again */
+    writer_reserve(w, n);
+    va_start(ap, fmt);
+    vsnprintf(w->buf + w->len, w->cap - w->len, fmt, ap);
+    va_end(ap);
+  }
+  w->len += n;
+  return n;
+}